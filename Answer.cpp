@@ -1,5 +1,12 @@
 #include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <initializer_list>
 #include <iostream>
@@ -7,32 +14,472 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <set>
+#include <unistd.h>
+#include <immintrin.h>
 
 #define X_MAX 17630
 #define Y_MAX 9000
 #define DEFAULT_SAME_DIR_MAX_ANGLE_DEG 20
 #define VECT_NORM 400
+#define TRIG_STEPS 4096		// trig tables resolution, steps per full turn (power of 2)
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)	// fixed point unit of the trig tables
+
+//	Game rules constants
+#define HERO_SPEED 800
+#define HERO_ATTACK_RANGE 800
+#define HERO_DAMAGE 2
+#define MONSTER_SPEED 400
+#define BASE_RADIUS 5000
+#define BASE_DAMAGE_RADIUS 300
+#define SPELL_COST 10
+#define SPELL_RANGE 2200
+#define WIND_RANGE 1280
+#define WIND_PUSH 2200
+#define SHIELD_DURATION 12
+#define HERO_VISION 2200
+#define BASE_VISION 6000
+#define MAX_HEROES 3
+#define MAX_MONSTERS 128
+#define FIRST_TURN_MS 1000	// time budget of the first turn
+#define TURN_MS 50			// time budget of the next turns
+#define DEADLINE_MARGIN_MS 10	// kept free for output and judge machine load
+#define FIRST_TURN_MARGIN_MS 100	// same on the first turn, also covering the process start and page faults
+#define EVAL_DEPTH 2		// rollout turns simulated past a search tree leaf
+#define MCTS_DEPTH 2		// turns covered by the search tree (one level per hero per turn)
+#define MCTS_ACTIONS 8		// candidate actions per hero in a search node
+#define MCTS_NODES (1 << 16)	// search tree node pool, recycled between turns
+#define MCTS_STABLE 1000	// iterations without a new node nor a new best root child that end the search
+#define MCTS_UCB_C 0.5		// UCB1 exploration constant, values are in [0, 1]
+#define MCTS_SCALE 3000.	// score giving a 0.88 value (tanh)
+#define RECORD_FILE "turns.rec"	// default turn log of -DRECORD builds, RECORD_FILE env var overrides it
+#define PROFILE_EVERY 20	// turns between two profiler summaries (compile with -DPROFILE)
+#define MAX_TRACKS 256		// entities remembered by WorldModel
+#define FOG_MEMORY 30		// turns a monster out of sight is still extrapolated
+#define ETA_HORIZON 40		// turns InterceptSolver follows a monster not heading to a base
+#define PATH_HORIZON 64		// turns a monster trajectory is projected, enough to cross the map
+#define WORLD_CAPACITY 192	// multiple of 64, >= MAX_MONSTERS + 2 * MAX_HEROES
+#define INTERCEPT_NONE 1000	// InterceptSolver turn of unreachable monsters
+#define WIND_DIRECTIONS 64	// WindSweep candidate directions, multiple of 8
+#define MAX_TASKS 32		// Assignment capacity, per turn candidate tasks
+#define ASSIGN_NONE (1 << 24)	// Assignment cost of a forbidden (hero, task) pair
+#define INFLUENCE_CELL 500	// InfluenceMap resolution
+#define INFLUENCE_W ((X_MAX + INFLUENCE_CELL - 1) / INFLUENCE_CELL)
+#define INFLUENCE_H ((Y_MAX + INFLUENCE_CELL - 1) / INFLUENCE_CELL)
+#define INFLUENCE_DECAY 0.9	// per turn weight of the past in InfluenceMap
+#define POST_WINDOW 1500	// half side of the threat area scored around a post candidate
+#define POST_MIN_THREAT 30.	// discounted threat (health * turns) around a post candidate before it leaves the default
+#define ZOBRIST_SHIFT 4		// positions are hashed at 1 << ZOBRIST_SHIFT units
+#define TT_BYTES (8 << 20)	// TranspositionTable memory, power of 2
+#define TT_WAYS 4			// entries per TranspositionTable bucket (one cache line)
+#define UNDO_FRAMES 16		// UndoLog depth
+#define UNDO_BYTES (64 << 10)	// UndoLog snapshots buffer
+#define DIST_CELL 100		// DistanceTable resolution
+#define POST_CANDIDATES 96	// positions a post may slide to, see Bot::_update_posts
+#define GRID_CELL 1280		// about the smallest neighbourhood query radius (wind range)
+#define GRID_W ((X_MAX + GRID_CELL - 1) / GRID_CELL)
+#define GRID_H ((Y_MAX + GRID_CELL - 1) / GRID_CELL)
 
 using namespace std;
 
 double	to_rad(const double deg) { return deg * M_PI / 180.; }
 double	to_deg(const double rad) { return rad * 180. / M_PI; }
 
-class Point
+//	Compile time sine table in FIX_ONE fixed point, TRIG_STEPS steps per turn (+1 for interpolation).
+//	Built with a Taylor series, as std::sin is not constexpr.
+struct TrigTable
+{
+	int		sin[TRIG_STEPS + 1];
+
+	constexpr TrigTable() : sin()
+	{
+		for (int i = 0; i <= TRIG_STEPS; ++i)
+		{
+			double	a = 2 * M_PI * i / TRIG_STEPS;
+			if (a > M_PI)
+				a -= 2 * M_PI;
+			double	term = a, sum = a;
+			for (int n = 1; n < 15; ++n)
+			{
+				term *= -a * a / ((2 * n) * (2 * n + 1));
+				sum += term;
+			}
+			sin[i] = (int)(sum * FIX_ONE + (sum >= 0 ? .5 : -.5));
+		}
+	}
+};
+static constexpr TrigTable	TRIG{};
+
+//	Fixed point sine and cosine of a table step (any integer, wraps around).
+inline int	fix_sin(int step) { return TRIG.sin[step & (TRIG_STEPS - 1)]; }
+inline int	fix_cos(int step) { return TRIG.sin[(step + TRIG_STEPS / 4) & (TRIG_STEPS - 1)]; }
+//	Same from radians, linearly interpolated between table steps.
+inline double	fix_sin(double rad)
+{
+	double	f = rad * (TRIG_STEPS / (2 * M_PI));
+	double	i = std::floor(f);
+	int		step = (int)i;
+	return fix_sin(step) + (f - i) * (fix_sin(step + 1) - fix_sin(step));
+}
+inline double	fix_cos(double rad) { return fix_sin(rad + M_PI / 2); }
+
+//	InputScanner source : read(2) on a file descriptor (stdin by default).
+struct FdSource
+{
+	FdSource(int fd = STDIN_FILENO) : fd(fd) {}
+	ssize_t	read(char* buf, int size) { return ::read(fd, buf, size); }
+	int		fd;
+};
+
+//	Buffered integer scanner on a source, a file descriptor by default.
+//	read(2) is only called when the buffer is exhausted, so a whole turn block is parsed
+//	from one or two syscalls, without any istream machinery nor ignore() calls.
+template<typename Source = FdSource>
+class BasicInputScanner
 {
 public:
-	Point() : x(0), y(0) {}
-	Point(const int x, const int y) : x(x), y(y) {}
-	Point(const Point& instance) : x(instance.x), y(instance.y) {}
+	static const int	BUFFER_SIZE = 1 << 16;
+
+	BasicInputScanner(const Source& source = Source()) : _source(source), _pos(0), _len(0), _eof(false), _tap(nullptr) {}
+
+	bool			eof() const { return _eof; }
+	//	Every integer read is also appended to tap (turn recording), nullptr to stop.
+	void			tap(std::vector<int>* tap) { _tap = tap; }
+
+	int				next_int()
+	{
+		int		c = _skip_blanks();
+		bool	neg = c == '-';
+		int		n = 0;
+		if (neg)
+			c = _next_char();
+		while (c >= '0' && c <= '9')
+		{
+			n = n * 10 + (c - '0');
+			c = _next_char();
+		}
+		if (_tap)
+			_tap->push_back(neg ? -n : n);
+		return neg ? -n : n;
+	}
+
+	BasicInputScanner&	operator>>(int& rhs)
+	{
+		rhs = next_int();
+		return *this;
+	}
+
+private:
+	int		_next_char()
+	{
+		if (_pos == _len && !_refill())
+			return -1;
+		return _buf[_pos++];
+	}
+	int		_skip_blanks()
+	{
+		int c = _next_char();
+		while (c != -1 && c != '-' && (c < '0' || c > '9'))
+			c = _next_char();
+		return c;
+	}
+	bool	_refill()
+	{
+		ssize_t n = _source.read(_buf, BUFFER_SIZE);
+		_pos = 0;
+		_len = n > 0 ? n : 0;
+		_eof = n <= 0;
+		return n > 0;
+	}
+
+	Source				_source;
+	int					_pos;
+	int					_len;
+	bool				_eof;
+	std::vector<int>*	_tap;
+	char				_buf[BUFFER_SIZE];
+};
+typedef BasicInputScanner<>	InputScanner;
 
-	Point&			operator=(const Point& rhs)
+//	Command output buffer, written to stdout with a single write(2) per turn by flush().
+class CommandWriter
+{
+public:
+	CommandWriter(int fd = STDOUT_FILENO) : _fd(fd), _len(0) {}
+	~CommandWriter() { flush(); }
+
+	CommandWriter&	operator<<(const char* str)
+	{
+		while (*str)
+			_put(*str++);
+		return *this;
+	}
+	CommandWriter&	operator<<(const std::string& str) { return *this << str.c_str(); }
+	CommandWriter&	operator<<(char c)
+	{
+		_put(c);
+		return *this;
+	}
+	CommandWriter&	operator<<(int n)
 	{
-		x = rhs.x;
-		y = rhs.y;
+		char			digits[12];
+		int				i = 0;
+		unsigned int	u = n < 0 ? -(unsigned int)n : n;
+		if (n < 0)
+			_put('-');
+		do
+			digits[i++] = '0' + u % 10;
+		while (u /= 10);
+		while (i)
+			_put(digits[--i]);
 		return *this;
 	}
 
+	const char*		data() const { return _buf; }
+	int				size() const { return _len; }
+
+	void			flush()
+	{
+		for (int done = 0; done < _len;)
+		{
+			ssize_t n = write(_fd, _buf + done, _len - done);
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		_len = 0;
+	}
+
+private:
+	static const int	BUFFER_SIZE = 4096;
+
+	void			_put(char c)
+	{
+		if (_len == BUFFER_SIZE)
+			flush();
+		_buf[_len++] = c;
+	}
+
+	int		_fd;
+	int		_len;
+	char	_buf[BUFFER_SIZE];
+};
+
+//	Turn log of -DRECORD builds, replayed offline by Replay.cpp. Native endianness, 4 bytes aligned :
+//	RecordHeader, init integers, then for each turn a RecordTurn followed by its input integers
+//	and its output text, zero padded to a multiple of 4 bytes.
+struct RecordHeader
+{
+	char		magic[8];	// RECORD_MAGIC
+	int32_t		init_count;
+	int32_t		search_iterations;	// MCTS iterations cap of the recorded bot
+};
+struct RecordTurn
+{
+	int32_t		input_count;
+	int32_t		output_len;
+	int64_t		elapsed_ns;	// read, decide and output time measured when recorded
+	int32_t		iterations;	// MCTS iterations completed before the deadline, replayed as a fixed cap
+	int32_t		reserved;
+};
+#define RECORD_MAGIC "SP22REC2"
+
+class TurnRecorder
+{
+public:
+	TurnRecorder(const char* path) : _file(fopen(path, "wb"))
+	{
+		if (!_file)
+			cerr << "Cannot record turns to " << path << endl;
+	}
+	~TurnRecorder()
+	{
+		if (_file)
+			fclose(_file);
+	}
+
+	void	init(const std::vector<int>& ints, int search_iterations)
+	{
+		RecordHeader header = {};
+		memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+		header.init_count = ints.size();
+		header.search_iterations = search_iterations;
+		_write(&header, sizeof(header));
+		_write(ints.data(), ints.size() * sizeof(int));
+	}
+	void	turn(const std::vector<int>& ints, const char* output, int output_len, int64_t elapsed_ns, int iterations)
+	{
+		static const char	padding[4] = {};
+		RecordTurn turn = {(int32_t)ints.size(), output_len, elapsed_ns, iterations, 0};
+		_write(&turn, sizeof(turn));
+		_write(ints.data(), ints.size() * sizeof(int));
+		_write(output, output_len);
+		_write(padding, -output_len & 3);
+		fflush(_file);	// the judge kills the bot at game end
+	}
+
+private:
+	void	_write(const void* data, size_t len)
+	{
+		if (_file && len)
+			fwrite(data, 1, len, _file);
+	}
+
+	FILE*	_file;
+};
+
+//	Hot path instrumentation, compiled only with -DPROFILE (the macros vanish otherwise) :
+//	PROFILE_SCOPE(phase) times the enclosing scope into the phase latency histogram,
+//	PROFILE_COUNT(counter, n) adds n to a named counter, PROFILE_TURN() closes a turn
+//	(with a compact stderr summary every PROFILE_EVERY turns), PROFILE_DUMP() prints everything.
+enum ProfilePhase { PROF_INIT, PROF_TURN, PROF_PARSE, PROF_REMAP, PROF_HERO, PROF_SEARCH, PROF_OUTPUT, PROF_PHASES };
+enum ProfileCounter { PROF_SETS, PROF_SCANNED, PROF_STEPS, PROF_ROLLOUTS, PROF_TT_HITS, PROF_COUNTERS };
+
+#ifdef PROFILE
+# define PROFILE_CAT_(a, b)			a##b
+# define PROFILE_CAT(a, b)			PROFILE_CAT_(a, b)
+# define PROFILE_SCOPE(phase)		ScopedTimer PROFILE_CAT(_profile_scope_, __LINE__)(phase)
+# define PROFILE_COUNT(counter, n)	(Profiler::get().counters[counter] += (n))
+# define PROFILE_TURN()				Profiler::get().end_turn()
+# define PROFILE_DUMP()				Profiler::get().dump()
+#else
+# define PROFILE_SCOPE(phase)		((void)0)
+# define PROFILE_COUNT(counter, n)	((void)0)
+# define PROFILE_TURN()				((void)0)
+# define PROFILE_DUMP()				((void)0)
+#endif
+
+//	Log-linear latency histogram in nanoseconds : 4 buckets per power of 2 (< 19% error).
+class LatencyHistogram
+{
+public:
+	static const int	BUCKETS = 4 * 40;
+
+	LatencyHistogram() : count(0), total_ns(0), max_ns(0), _buckets() {}
+
+	int64_t		count;
+	int64_t		total_ns;
+	int64_t		max_ns;
+
+	void		add(int64_t ns)
+	{
+		++count;
+		total_ns += ns;
+		max_ns = std::max(max_ns, ns);
+		++_buckets[_bucket(ns)];
+	}
+	//	Upper bound of the bucket holding the q quantile (0 < q <= 1).
+	int64_t		quantile(double q) const
+	{
+		int64_t rank = std::max<int64_t>(1, std::ceil(q * count));
+		for (int b = 0, seen = 0; b < BUCKETS; ++b)
+			if ((seen += _buckets[b]) >= rank)
+				return std::min(_upper(b), max_ns);
+		return max_ns;
+	}
+	int64_t		bucket_count(int b) const { return _buckets[b]; }
+	static int64_t	bucket_upper(int b) { return _upper(b); }
+
+private:
+	static int		_bucket(int64_t ns)
+	{
+		if (ns < 4)
+			return ns < 0 ? 0 : ns;
+		int	log = 63 - __builtin_clzll(ns);
+		return std::min(BUCKETS - 1, 4 * (log - 1) + (int)((ns >> (log - 2)) & 3));
+	}
+	static int64_t	_upper(int b)
+	{
+		if (b < 4)
+			return b;
+		int	log = b / 4 + 1;
+		return ((int64_t)(4 + b % 4 + 1) << (log - 2)) - 1;
+	}
+
+	int64_t		_buckets[BUCKETS];
+};
+
+class Profiler
+{
+public:
+	static Profiler&	get()
+	{
+		static Profiler	profiler;
+		return profiler;
+	}
+
+	LatencyHistogram	phases[PROF_PHASES];
+	int64_t				counters[PROF_COUNTERS];
+	int					turns;
+
+	void	end_turn()
+	{
+		if (++turns % PROFILE_EVERY)
+			return;
+		cerr << "profile @" << turns << " :";
+		for (int p = 0; p < PROF_PHASES; ++p)
+			if (phases[p].count)
+				cerr << " " << phase_name(p) << " p50 " << phases[p].quantile(.5) / 1000. << " p99 "
+					<< phases[p].quantile(.99) / 1000. << " us;";
+		cerr << endl;
+	}
+
+	void	dump() const
+	{
+		cerr << "==== profile after " << turns << " turns" << endl;
+		for (int p = 0; p < PROF_PHASES; ++p)
+		{
+			const LatencyHistogram& h = phases[p];
+			if (!h.count)
+				continue;
+			cerr << phase_name(p) << " : n " << h.count << " avg " << h.total_ns / h.count / 1000. << " us, p50 "
+				<< h.quantile(.5) / 1000. << " p90 " << h.quantile(.9) / 1000. << " p99 " << h.quantile(.99) / 1000.
+				<< " max " << h.max_ns / 1000. << " us" << endl;
+			for (int b = 0; b < LatencyHistogram::BUCKETS; ++b)
+				if (h.bucket_count(b))
+					cerr << "  <= " << LatencyHistogram::bucket_upper(b) << " ns : " << h.bucket_count(b) << endl;
+		}
+		for (int c = 0; c < PROF_COUNTERS; ++c)
+			cerr << counter_name(c) << " : " << counters[c] << " (" << (turns ? counters[c] / turns : 0) << " per turn)" << endl;
+	}
+
+	static const char*	phase_name(int p)
+	{
+		static const char* names[PROF_PHASES] = {"init", "turn", "parse", "remap", "hero", "search", "output"};
+		return names[p];
+	}
+	static const char*	counter_name(int c)
+	{
+		static const char* names[PROF_COUNTERS] = {"sets built", "entities scanned", "sims stepped", "rollouts", "rollouts cached"};
+		return names[c];
+	}
+
+private:
+	Profiler() : counters(), turns(0) {}
+};
+
+class ScopedTimer	//	RAII phase timer, see PROFILE_SCOPE.
+{
+public:
+	ScopedTimer(ProfilePhase phase) : _phase(phase), _start(std::chrono::steady_clock::now()) {}
+	~ScopedTimer()
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+		Profiler::get().phases[_phase].add(ns);
+	}
+private:
+	ProfilePhase							_phase;
+	std::chrono::steady_clock::time_point	_start;
+};
+
+class Point
+{
+public:
+	Point() : x(0), y(0) {}
+	Point(const int x, const int y) : x(x), y(y) {}
+	Point(const Point& instance) = default;	// trivially copyable, states are memcpy'ed
+	Point&			operator=(const Point& rhs) = default;
+
 	int x;
 	int y;
 
@@ -54,20 +501,28 @@ public:
 	Point			abs() const { return Point(std::abs(x), std::abs(y)); }
 	friend Point	abs(const Point& p) { return p.abs(); }
 
-	int				dist(const Point& b) const
+	// Squared distance, 64 bits so it never overflows even far out of the map.
+	int64_t			dist2(const Point& b) const
 	{
-		int dx = std::abs(x - b.x);
-		int dy = std::abs(y - b.y);
-		return std::sqrt(dx * dx + dy * dy);
+		int64_t dx = x - b.x;
+		int64_t dy = y - b.y;
+		return dx * dx + dy * dy;
 	}
+	friend int64_t	dist2(const Point& a, const Point& b) { return a.dist2(b); }
+	int				dist(const Point& b) const { return std::sqrt((double)dist2(b)); }
 	friend int		dist(const Point& a, const Point& b) { return a.dist(b); }
+	// Same as dist(b) <= r (truncated distance) without sqrt : d2 < (r + 1)^2
+	bool			in_range(const Point& b, int r) const { return r >= 0 && dist2(b) < (int64_t)(r + 1) * (r + 1); }
+	friend bool		in_range(const Point& a, const Point& b, int r) { return a.in_range(b, r); }
 
-	friend ostream& operator<<(ostream& out, const Point& rhs)
+	template<typename Out>
+	friend Out&		operator<<(Out& out, const Point& rhs)
 	{
 		out << rhs.x << " " << rhs.y;
 		return out;
 	}
-	friend istream& operator>>(istream& in, Point& rhs)
+	template<typename In>
+	friend In&		operator>>(In& in, Point& rhs)
 	{
 		in >> rhs.x >> rhs.y;
 		return in;
@@ -83,16 +538,10 @@ struct Vect
 {
 	Vect() : x(), y() {}
 	Vect(int x, int y) : x(x), y(y) {}		// BE CAREFUL TO CALL THE RIGHT CONSTRUCTOR (int, int) or (int, double)
-	Vect(int norm, double dir) : x(norm*cos(dir)), y(norm*sin(dir)) {}	//	dir is in radians, call to_rad(double) to use degrees.
+	Vect(int norm, double dir) : x(norm * fix_cos(dir) / FIX_ONE), y(norm * fix_sin(dir) / FIX_ONE) {}	//	dir is in radians, call to_rad(double) to use degrees.
 	Vect(const Point& origin, const Point& dest) : x(dest.x-origin.x), y(dest.y-origin.y) {}
-	Vect(const Vect& instance) : x(instance.x), y(instance.y) {}
-
-	Vect&			operator=(const Vect& rhs)
-	{
-		x = rhs.x;
-		y = rhs.y;
-		return *this;
-	}
+	Vect(const Vect& instance) = default;
+	Vect&			operator=(const Vect& rhs) = default;
 
 	int x;
 	int y;
@@ -106,28 +555,47 @@ struct Vect
 	bool			operator==(const Vect& v) const { return x == v.x && y == v.y; }
 	bool			operator!=(const Vect& v) const { return	!(*this == v); }
 
+	//	Vector of a given norm at a trig table step (TRIG_STEPS per turn), no libm call.
+	static Vect		polar(int norm, int step)
+	{
+		return Vect((int)((int64_t)norm * fix_cos(step) / FIX_ONE), (int)((int64_t)norm * fix_sin(step) / FIX_ONE));
+	}
+
 	double			dir() const { return atan2(y, x); } //	Direction of a vector [-Pi, Pi]
 	friend double	dir(const Vect& v) { return v.dir(); }
 	double			angle(const Vect& v) const
 	{
-		return	abs(dir() - v.dir());
-	} //	Absolute minimum angle between two vectors. [0, Pi]
+		return	atan2(std::abs((double)cross(v)), (double)dot(v));
+	} //	Absolute minimum angle between two vectors, correct across the -Pi/Pi wrap. [0, Pi]
 	friend double	angle(const Vect& v1, const Vect& v2) { return v1.angle(v2); }
+	//	Integer key growing with angle(v), from 0 (same direction) to 2 * FIX_ONE (opposite) :
+	//	FIX_ONE * (1 - cos(angle)). Use angle_key(rad) to get the key of a threshold angle.
+	int				angle_key(const Vect& v) const
+	{
+		double n = std::sqrt((double)norm2() * v.norm2());
+		return n ? FIX_ONE - (int)(FIX_ONE * dot(v) / n) : FIX_ONE;
+	}
+	static int		angle_key(double rad) { return FIX_ONE - (int)fix_cos(rad); }
 
 	// Norm (length) of vector ( But all monsters vxy norm is 400 for info )
-	double			norm() const
+	int64_t			norm2() const { return (int64_t)x * x + (int64_t)y * y; }
+	double			norm() const { return std::sqrt((double)norm2()); }
+	friend double	norm(const Vect& v) { return v.norm(); }
+	//	Same direction with a given norm, without going through trig.
+	Vect			scaled(int len) const
 	{
-		int dx = std::abs(x);
-		int dy = std::abs(y);
-		return std::sqrt(dx * dx + dy * dy);
+		double n = norm();
+		return n ? Vect((int)(x * len / n), (int)(y * len / n)) : Vect();
 	}
-	friend double	norm(const Vect& v) { return v.norm(); }
-	Vect			normalize() const { return Vect(100, dir()); }
+	Vect			normalize() const { return scaled(100); }
 	friend Vect		normalize(const Vect& v) { return v.normalize(); }
 
-	// Scalar product (is > 0 if angle > 90 degrees)
-	int				scal_prod(const Vect& v) const { return x * v.x + y * v.y; }
-	friend int		scal_prod(const Vect& v1, const Vect& v2)
+	// Dot product (is > 0 if angle < 90 degrees), 64 bits safe.
+	int64_t			dot(const Vect& v) const { return (int64_t)x * v.x + (int64_t)y * v.y; }
+	// Cross product z (is > 0 if v is counterclockwise from this, 0 if colinear).
+	int64_t			cross(const Vect& v) const { return (int64_t)x * v.y - (int64_t)y * v.x; }
+	int64_t			scal_prod(const Vect& v) const { return dot(v); }
+	friend int64_t	scal_prod(const Vect& v1, const Vect& v2)
 	{
 		return v1.scal_prod(v2);
 	}
@@ -135,7 +603,7 @@ struct Vect
 	// are vectors going approximately same direction ? (angle <= max_angle)
 	bool			same_dir(const Vect& v, double max_angle) const
 	{
-		return	angle(v) <= max_angle;
+		return	_cos_at_least(v, fix_cos(max_angle) / FIX_ONE);
 	}
 	friend bool		same_dir(const Vect& v1, const Vect& v2, double max_angle)
 	{
@@ -144,30 +612,101 @@ struct Vect
 	// simplified version using DEFAULT_SAME_DIR_MAX_ANGLE_DEG
 	bool			same_dir(const Vect& v) const
 	{
-		static const double MAX_ANGLE_RAD = to_rad(DEFAULT_SAME_DIR_MAX_ANGLE_DEG);
-		return		angle(v) <= MAX_ANGLE_RAD;
+		static const double MAX_ANGLE_COS = fix_cos(to_rad(DEFAULT_SAME_DIR_MAX_ANGLE_DEG)) / FIX_ONE;
+		return		_cos_at_least(v, MAX_ANGLE_COS);
 	}
 	friend bool		same_dir(const Vect& v1, const Vect& v2)
 	{
 		return v1.same_dir(v2);
 	}
 
-	friend istream& operator>>(istream& in, Vect& rhs)
+	template<typename In>
+	friend In&		operator>>(In& in, Vect& rhs)
 	{
 		in >> rhs.x >> rhs.y;
 		return in;
 	}
+
+private:
+	//	cos(angle(v)) >= c, from dot product and norms only.
+	bool			_cos_at_least(const Vect& v, double c) const
+	{
+		return dot(v) >= c * std::sqrt((double)norm2() * v.norm2());
+	}
 };
 
 //	For retrieving a destination point by adding a point and a vector.
 Point			operator+(const Point& p, const Vect& v) { return Point(p.x+v.x, p.y+v.y); }
 
+//	Random keys of the state hash features, from a fixed seed. A feature key is the xor of the keys of
+//	its fields, mixed so that the fields of different entities cannot cancel out.
+struct Zobrist
+{
+	static const int	IDS = 1024;		// ids are masked, they are sequential
+	static const int	XS = (X_MAX >> ZOBRIST_SHIFT) + 1;
+	static const int	YS = (Y_MAX >> ZOBRIST_SHIFT) + 1;
+	static const int	VALUES = 128;	// health, masked
+	static const int	MANA = 1024;	// masked
+	static const int	SPEEDS = 2 * MONSTER_SPEED + 1;	// velocity components, clamped
+
+	uint64_t	id[IDS];
+	uint64_t	x[XS];
+	uint64_t	y[YS];
+	uint64_t	health[VALUES];
+	uint64_t	shield[SHIELD_DURATION + 1];
+	uint64_t	controlled[2];
+	uint64_t	vx[SPEEDS];
+	uint64_t	vy[SPEEDS];
+	uint64_t	course[2][4];	// near_base, threat_for + 1
+	uint64_t	pending;		// pending CONTROL salt
+	uint64_t	mana[2][MANA];
+	uint64_t	base_health[2][8];
+
+	Zobrist()
+	{
+		uint64_t	seed = 0x5EED2022;
+		auto		fill = [&](uint64_t* keys, int n)
+		{
+			for (int i = 0; i < n; ++i)
+				keys[i] = mix(seed += 0x9e3779b97f4a7c15ULL);
+		};
+		fill(id, IDS);
+		fill(x, XS);
+		fill(y, YS);
+		fill(health, VALUES);
+		fill(shield, SHIELD_DURATION + 1);
+		fill(controlled, 2);
+		fill(vx, SPEEDS);
+		fill(vy, SPEEDS);
+		fill(&course[0][0], 2 * 4);
+		fill(&pending, 1);
+		fill(&mana[0][0], 2 * MANA);
+		fill(&base_health[0][0], 2 * 8);
+	}
+
+	static uint64_t	mix(uint64_t h)		// splitmix64 finalizer
+	{
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		return h ^ (h >> 31);
+	}
+	static int		qx(int x) { return std::min(std::max(x, 0), X_MAX) >> ZOBRIST_SHIFT; }
+	static int		qy(int y) { return std::min(std::max(y, 0), Y_MAX) >> ZOBRIST_SHIFT; }
+	static int		qv(int v) { return std::min(std::max(v, -MONSTER_SPEED), MONSTER_SPEED) + MONSTER_SPEED; }
+};
+
+static const Zobrist	ZOBRIST;
+
 struct Player
 {
 	int health; // Each player's base health
 	int mana;   // Ignore in the first league; Spend ten mana to cast a spell
 
-	friend istream& operator>>(istream& in, Player& rhs)
+	//	State hash key of player p (0 is us).
+	uint64_t	zobrist(int p) const { return ZOBRIST.mana[p][mana & (Zobrist::MANA - 1)] ^ ZOBRIST.base_health[p][health & 7]; }
+
+	template<typename In>
+	friend In&		operator>>(In& in, Player& rhs)
 	{
 		in >> rhs.health >> rhs.mana;
 		return in;
@@ -178,17 +717,14 @@ struct Base
 {
 	Point xy;
 	Point adv;
-	std::vector<Point> posts;
+	Point posts[MAX_HEROES];	// map coordinates, already mirrored for the bottom right base
 
-	Point get_post(int i)
-	{
-		posts.resize(3);
-		if (xy.x)
-			return adv-posts[i];
-		return posts[i];
-	}
+	Point get_post(int i) const { return posts[i]; }
+	//	From our own corner coordinates (angles and radii from the base) to map coordinates.
+	Point mirror(const Point& p) const { return xy.x ? xy - p : p; }
 
-	friend istream& operator>>(istream& in, Base& rhs)
+	template<typename In>
+	friend In&		operator>>(In& in, Base& rhs)
 	{
 		in >> rhs.xy;
 		rhs.adv = P_MAX - rhs.xy;
@@ -211,7 +747,22 @@ struct Entity
 
 	void	displace(const Vect& v) { xy = xy+v; dst = dst+v; }
 
-	friend istream& operator>>(istream& in, Entity& rhs)
+	//	State hash key : id, quantized position, health, shield, control, velocity and course (the base
+	//	targeting flags), everything the next turns of a monster depend on.
+	uint64_t	zobrist() const
+	{
+		return Zobrist::mix(ZOBRIST.id[id & (Zobrist::IDS - 1)] ^ ZOBRIST.x[Zobrist::qx(xy.x)] ^ ZOBRIST.y[Zobrist::qy(xy.y)]
+			^ ZOBRIST.health[health & (Zobrist::VALUES - 1)] ^ ZOBRIST.shield[std::min(std::max(shield_life, 0), SHIELD_DURATION)]
+			^ ZOBRIST.controlled[is_controlled & 1] ^ ZOBRIST.vx[Zobrist::qv(vxy.x)] ^ ZOBRIST.vy[Zobrist::qv(vxy.y)]
+			^ ZOBRIST.course[near_base & 1][(threat_for + 1) & 3]);
+	}
+	//	Mutators keeping a state hash up to date : the old key is xored out, the new one in.
+	void	displace(const Vect& v, uint64_t& hash) { hash ^= zobrist(); displace(v); hash ^= zobrist(); }
+	template<typename F>
+	void	update(uint64_t& hash, F mutate) { hash ^= zobrist(); mutate(*this); hash ^= zobrist(); }
+
+	template<typename In>
+	friend In&		operator>>(In& in, Entity& rhs)
 	{
 		in >> rhs.id >> rhs.type >> rhs.xy.x >> rhs.xy.y >> rhs.shield_life >> rhs.is_controlled;
 		in >> rhs.health >> rhs.vxy.x >> rhs.vxy.y >> rhs.near_base >> rhs.threat_for;
@@ -220,320 +771,3193 @@ struct Entity
 	}
 };
 
-static const std::map<std::string, int Entity::*> EntityIntMembers = {
-	{"id", &Entity::id},
-	{"type", &Entity::type},
-	{"shield_life", &Entity::shield_life},
-	{"is_controlled", &Entity::is_controlled},
-	{"health", &Entity::health},
-	{"near_base", &Entity::near_base},
-	{"threat_for", &Entity::threat_for}
-};
-
-class EntityCompare		// Gereric virtual binary predicate on entities or pointer on entities.
-{
-public:
-	virtual bool	operator()(const Entity& a, const Entity& b) const final { return compared_value(a) < compared_value(b); };
-	virtual	bool	operator()(const Entity* a, const Entity* b) const final { return compared_value(*a) < compared_value(*b); };
-	virtual	int		compared_value(const Entity& e) const { return e.id; }
-};
-
-class EntityMemberCompare : public EntityCompare	// Binary predicate comparing int members of two entities.
+//	Fixed capacity inline entity storage, with the std::vector subset the turn parsing uses :
+//	no allocation, trivially copyable. Callers check full() before adding.
+template<int N>
+class EntityArray
 {
 public:
-	EntityMemberCompare(const std::string& member) {
-		auto f = EntityIntMembers.find(member);
-		if (f != EntityIntMembers.end())
-			_ptr_m = f->second;
-		else
-			_ptr_m = &Entity::id;
+	EntityArray() : _count(0) {}
+
+	Entity*			begin() { return _items; }
+	Entity*			end() { return _items + _count; }
+	const Entity*	begin() const { return _items; }
+	const Entity*	end() const { return _items + _count; }
+	int				size() const { return _count; }
+	bool			empty() const { return !_count; }
+	bool			full() const { return _count == N; }
+	Entity&			operator[](int i) { return _items[i]; }
+	const Entity&	operator[](int i) const { return _items[i]; }
+	Entity&			back() { return _items[_count - 1]; }
+
+	void			clear() { _count = 0; }
+	Entity&			emplace_back()
+	{
+		assert(_count < N);
+		return _items[_count++] = Entity();
 	}
-	virtual	int		compared_value(const Entity& e) const { return e.*_ptr_m; }
-private:
-	int Entity::* _ptr_m;
-};
-
-class EntityDistCompare : public EntityCompare		// Binary predicate comparing entities distance to a given reference point.
-{
-public:
-	EntityDistCompare(const Point& ref_point) : p(ref_point) {}
-	EntityDistCompare(Point&& ref_point) : p(std::move(ref_point)) {}
-	virtual	int		compared_value(const Entity& e) const { return e.xy.dist(p); }
-private:
-	const Point p;
-};
+	void			push_back(const Entity& e) { emplace_back() = e; }
+	void			pop_back() { --_count; }
 
-class EntityDestCompare : public EntityCompare		// Binary predicate comparing entities distance to a given reference point.
-{
-public:
-	EntityDestCompare(const Point& ref_point) : p(ref_point) {}
-	EntityDestCompare(Point&& ref_point) : p(std::move(ref_point)) {}
-	virtual	int		compared_value(const Entity& e) const { return e.dst.dist(p); }
 private:
-	const Point p;
+	Entity	_items[N];
+	int		_count;
 };
 
-class EntityAngleCompare : public EntityCompare		// Binary predicate comparing entities direction vector angle to a to a given reference vector.
-{
-public:
-	EntityAngleCompare(const Vect& ref_vect) : v(ref_vect) {}
-	EntityAngleCompare(Vect&& ref_vect) : v(std::move(ref_vect)) {}
-	virtual	int		compared_value(const Entity& e) const { return e.vxy.angle(v); }
-private:
-	const Vect v;
-};
+class World;
 
-class EntitySelect		// Gereric virtual unary predicate on entities or pointer on entities.
+class EntityMask	// Bitmask over World slots, iterable as a container of entity pointers.
 {
 public:
-	EntitySelect(int max) : _mode(0), _max(max) {}
-	EntitySelect(int min, int max) : _mode(1), _min(min), _max(max) {}
-	EntitySelect(const std::initializer_list<int>& values) : _mode(2), _values(values) {}
-	EntitySelect(std::initializer_list<int>&& values) : _mode(2), _values(std::move(values)) {}
-	virtual	int		selected_value(const Entity& e) const = 0;
+	static const int	WORDS = WORLD_CAPACITY / 64;
 
-	virtual bool	operator()(const Entity* e) const final { return (*this)(*e); }
-	virtual bool	operator()(const Entity& e) const final
+	class iterator
 	{
-		switch(_mode)
+	public:
+		iterator(const EntityMask& mask, int slot) : _mask(&mask), _slot(slot) {}
+		Entity*		operator*() const;
+		iterator&	operator++() { _slot = _mask->next(_slot + 1); return *this; }
+		bool		operator==(const iterator& rhs) const { return _slot == rhs._slot; }
+		bool		operator!=(const iterator& rhs) const { return _slot != rhs._slot; }
+		int			slot() const { return _slot; }
+	private:
+		const EntityMask*	_mask;
+		int					_slot;
+	};
+
+	explicit EntityMask(const World* world = nullptr) : w(), _world(world) {}
+
+	uint64_t	w[WORDS];
+
+	void		set(int slot) { w[slot >> 6] |= 1ULL << (slot & 63); }
+	void		reset(int slot) { w[slot >> 6] &= ~(1ULL << (slot & 63)); }
+	bool		test(int slot) const { return w[slot >> 6] >> (slot & 63) & 1; }
+	int			count() const
+	{
+		int n = 0;
+		for (int i = 0; i < WORDS; ++i)
+			n += __builtin_popcountll(w[i]);
+		return n;
+	}
+	bool		any() const
+	{
+		for (int i = 0; i < WORDS; ++i)
+			if (w[i])
+				return true;
+		return false;
+	}
+	int			next(int slot) const	//	First set slot >= slot, or WORLD_CAPACITY.
+	{
+		for (int i = slot >> 6; i < WORDS; ++i)
 		{
-			case 0:		return selected_value(e) <= _max;
-			case 1:		return _min <= selected_value(e) && selected_value(e) <= _max;
-			case 2:		return std::find(_values.begin(), _values.end(), selected_value(e)) != _values.end();
-			default:	return false;
+			uint64_t bits = w[i];
+			if (i == slot >> 6)
+				bits &= ~0ULL << (slot & 63);
+			if (bits)
+				return (i << 6) + __builtin_ctzll(bits);
 		}
+		return WORLD_CAPACITY;
+	}
+	iterator	begin() const { return iterator(*this, next(0)); }
+	iterator	end() const { return iterator(*this, WORLD_CAPACITY); }
+
+	const World*	world() const { return _world; }
+
+	EntityMask	operator&(const EntityMask& rhs) const { EntityMask m(*this); return m &= rhs; }
+	EntityMask	operator|(const EntityMask& rhs) const { EntityMask m(*this); return m |= rhs; }
+	EntityMask	operator-(const EntityMask& rhs) const	//	Slots of this mask not in rhs.
+	{
+		EntityMask m(*this);
+		for (int i = 0; i < WORDS; ++i)
+			m.w[i] &= ~rhs.w[i];
+		return m;
+	}
+	EntityMask&	operator&=(const EntityMask& rhs)
+	{
+		for (int i = 0; i < WORDS; ++i)
+			w[i] &= rhs.w[i];
+		return *this;
+	}
+	EntityMask&	operator|=(const EntityMask& rhs)
+	{
+		for (int i = 0; i < WORDS; ++i)
+			w[i] |= rhs.w[i];
+		if (!_world)
+			_world = rhs._world;
+		return *this;
 	}
 private:
-	int							_mode;
-	std::initializer_list<int>	_values;
-	int 						_min;
-	int 						_max;
+	const World*	_world;
 };
 
-class EntityMemberSelect : public EntitySelect		// Unnary predicate selecting entities on a member value.
+//	Uniform grid of World slots over the map, as doubly linked lists per cell (no allocation).
+//	Entities outside of the map are kept in the border cells, so queries never miss them.
+class SpatialGrid
 {
 public:
-	EntityMemberSelect(const std::string& member, int max) : _ptr_m(_init_ptr(member)), EntitySelect(max) {}
-	EntityMemberSelect(const std::string& member, int min, int max) : _ptr_m(_init_ptr(member)), EntitySelect(min, max) {}
-	EntityMemberSelect(const std::string& member, const std::initializer_list<int>& values) : _ptr_m(_init_ptr(member)), EntitySelect(values) {}
-	EntityMemberSelect(const std::string& member, std::initializer_list<int>&& values) : _ptr_m(_init_ptr(member)), EntitySelect(std::move(values)) {}
-	virtual	int				selected_value(const Entity& e) const { return e.*_ptr_m; }
+	SpatialGrid() { clear(); }
+
+	void		clear()
+	{
+		std::fill(_head, _head + GRID_W * GRID_H, -1);
+		std::fill(_cell, _cell + WORLD_CAPACITY, -1);
+	}
+	void		insert(int slot, const Point& p)
+	{
+		int c = cell(p);
+		_cell[slot] = c;
+		_prev[slot] = -1;
+		_next[slot] = _head[c];
+		if (_head[c] >= 0)
+			_prev[_head[c]] = slot;
+		_head[c] = slot;
+	}
+	void		remove(int slot)
+	{
+		int c = _cell[slot];
+		if (c < 0)
+			return;
+		if (_prev[slot] >= 0)
+			_next[_prev[slot]] = _next[slot];
+		else
+			_head[c] = _next[slot];
+		if (_next[slot] >= 0)
+			_prev[_next[slot]] = _prev[slot];
+		_cell[slot] = -1;
+	}
+	//	Incremental update, only relinks when the slot changes of cell.
+	void		move(int slot, const Point& p)
+	{
+		if (cell(p) == _cell[slot])
+			return;
+		remove(slot);
+		insert(slot, p);
+	}
+
+	//	Calls f(slot) for every slot in cells intersecting the [min, max] annulus around p.
+	//	Cells entirely inside the inner circle are skipped. Candidates still need an exact test.
+	template<typename F>
+	void		candidates(const Point& p, int min, int max, F f) const
+	{
+		const int	cx0 = cell_x(p.x - max), cx1 = cell_x(p.x + max);
+		const int	cy0 = cell_y(p.y - max), cy1 = cell_y(p.y + max);
+		const int64_t	min2 = (int64_t)min * min;
+		for (int cy = cy0; cy <= cy1; ++cy)
+			for (int cx = cx0; cx <= cx1; ++cx)
+			{
+				if (min > 0 && !_border(cx, cy) && _far_corner2(p, cx, cy) < min2)
+					continue;
+				for (int slot = _head[cy * GRID_W + cx]; slot >= 0; slot = _next[slot])
+					f(slot);
+			}
+	}
+
+	static int	cell_x(int x) { return std::min(std::max(x, 0) / GRID_CELL, GRID_W - 1); }
+	static int	cell_y(int y) { return std::min(std::max(y, 0) / GRID_CELL, GRID_H - 1); }
+	static int	cell(const Point& p) { return cell_y(p.y) * GRID_W + cell_x(p.x); }
+
 private:
-	static int Entity::*	_init_ptr(const std::string& member)
+	static bool	_border(int cx, int cy) { return !cx || !cy || cx == GRID_W - 1 || cy == GRID_H - 1; }
+	static int64_t	_far_corner2(const Point& p, int cx, int cy)
+	{
+		int64_t dx = std::max(std::abs(p.x - cx * GRID_CELL), std::abs(p.x - (cx + 1) * GRID_CELL));
+		int64_t dy = std::max(std::abs(p.y - cy * GRID_CELL), std::abs(p.y - (cy + 1) * GRID_CELL));
+		return dx * dx + dy * dy;
+	}
+
+	int		_head[GRID_W * GRID_H];
+	int		_next[WORLD_CAPACITY];
+	int		_prev[WORLD_CAPACITY];
+	int		_cell[WORLD_CAPACITY];
+};
+
+//	Structure of arrays copy of entities, for one pass SIMD selections returning EntityMask.
+//	Entities stay owned by their containers, ref[] links each slot back to its source.
+//	A SpatialGrid over the slots answers small radius queries (near) without a full scan.
+class World
+{
+public:
+	enum Field { ID, TYPE, HEALTH, SHIELD_LIFE, IS_CONTROLLED, NEAR_BASE, THREAT_FOR, FIELDS };
+
+	World() : x(), y(), vx(), vy(), dst_x(), dst_y(), fields(), ref(), count(0) {}
+
+	alignas(32) int	x[WORLD_CAPACITY];
+	alignas(32) int	y[WORLD_CAPACITY];
+	alignas(32) int	vx[WORLD_CAPACITY];
+	alignas(32) int	vy[WORLD_CAPACITY];
+	alignas(32) int	dst_x[WORLD_CAPACITY];
+	alignas(32) int	dst_y[WORLD_CAPACITY];
+	alignas(32) int	fields[FIELDS][WORLD_CAPACITY];
+	Entity*			ref[WORLD_CAPACITY];
+	int				count;
+
+	void		clear()
+	{
+		count = 0;
+		_grid.clear();
+	}
+	int			add(Entity& e)
+	{
+		if (count >= WORLD_CAPACITY)
+			return -1;
+		ref[count] = &e;
+		_grid.insert(count, e.xy);
+		sync(count);
+		return count++;
+	}
+	template<typename... Containers>
+	void		load(Containers&... src_containers)
+	{
+		clear();
+		(void)std::initializer_list<int>{(_int_load(src_containers), 0)...};
+	}
+
+	//	Reloads slots from their source entities (after a displace for instance), grid included.
+	void		sync(int slot)
+	{
+		const Entity& e = *ref[slot];
+		_grid.move(slot, e.xy);
+		x[slot] = e.xy.x;
+		y[slot] = e.xy.y;
+		vx[slot] = e.vxy.x;
+		vy[slot] = e.vxy.y;
+		dst_x[slot] = e.dst.x;
+		dst_y[slot] = e.dst.y;
+		fields[ID][slot] = e.id;
+		fields[TYPE][slot] = e.type;
+		fields[HEALTH][slot] = e.health;
+		fields[SHIELD_LIFE][slot] = e.shield_life;
+		fields[IS_CONTROLLED][slot] = e.is_controlled;
+		fields[NEAR_BASE][slot] = e.near_base;
+		fields[THREAT_FOR][slot] = e.threat_for;
+	}
+	void		sync(const EntityMask& mask)
+	{
+		for (auto it = mask.begin(); it != mask.end(); ++it)
+			sync(it.slot());
+	}
+
+	EntityMask	all() const
+	{
+		EntityMask m(this);
+		for (int i = 0; i < EntityMask::WORDS; ++i)
+		{
+			int n = count - (i << 6);
+			m.w[i] = n >= 64 ? ~0ULL : n > 0 ? (1ULL << n) - 1 : 0;
+		}
+		return m;
+	}
+
+	//	Same semantic as Point::dist (truncated), without any sqrt : dist <= max  <=>  d2 < (max + 1)^2
+	EntityMask	in_range(const Point& p, int max) const { return _dist_kernel(x, y, p, 0, max); }
+	EntityMask	in_range(const Point& p, int min, int max) const { return _dist_kernel(x, y, p, min, max); }
+	EntityMask	dst_in_range(const Point& p, int max) const { return _dist_kernel(dst_x, dst_y, p, 0, max); }
+	EntityMask	dst_in_range(const Point& p, int min, int max) const { return _dist_kernel(dst_x, dst_y, p, min, max); }
+
+	//	Grid backed equivalents of in_range, cheaper for radii about the grid cell size.
+	EntityMask	near(const Point& p, int max) const { return near(p, 0, max); }
+	EntityMask	near(const Point& p, int min, int max) const
+	{
+		EntityMask	m(this);
+		if (max < 0)
+			return m;
+		const int	lo = min > 0 ? min * min : 0;
+		const int	hi = (std::min(max, 46339) + 1) * (std::min(max, 46339) + 1);
+		_grid.candidates(p, min, max, [&](int slot)
+		{
+			int d2 = (x[slot] - p.x) * (x[slot] - p.x) + (y[slot] - p.y) * (y[slot] - p.y);
+			if (lo <= d2 && d2 < hi)
+				m.set(slot);
+		});
+		return m;
+	}
+	const SpatialGrid&	grid() const { return _grid; }
+	int			slot(const Entity* e) const
+	{
+		for (int i = 0; i < count; ++i)
+			if (ref[i] == e)
+				return i;
+		return -1;
+	}
+
+	EntityMask	match(Field f, int value) const { return _range_kernel(fields[f], value, value); }
+	EntityMask	match(Field f, int min, int max) const { return _range_kernel(fields[f], min, max); }
+
+private:
+	SpatialGrid	_grid;
+
+	template<typename Container>
+	void		_int_load(Container& src_container)
+	{
+		for (auto it = src_container.begin(); it != src_container.end(); ++it)
+			add(*it);
+	}
+
+	//	AVX2 through the target attribute only (CodinGame judges support it, submissions get no -mavx2),
+	//	8 slots per pass : slots up to the next multiple of 8 are read, then cut by all().
+	__attribute__((target("avx2")))
+	EntityMask	_dist_kernel(const int* xs, const int* ys, const Point& p, int min, int max) const
+	{
+		EntityMask	m(this);
+		const int	lo = min > 0 ? min * min : 0;
+		const int	hi = (std::min(max, 46339) + 1) * (std::min(max, 46339) + 1);
+		if (max < 0)
+			return m;
+		const __m256i	px = _mm256_set1_epi32(p.x), py = _mm256_set1_epi32(p.y);
+		const __m256i	vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+		for (int i = 0; i < count; i += 8)
+		{
+			__m256i	dx = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(xs + i)), px);
+			__m256i	dy = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(ys + i)), py);
+			__m256i	d2 = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+			__m256i	ok = _mm256_andnot_si256(_mm256_cmpgt_epi32(vlo, d2), _mm256_cmpgt_epi32(vhi, d2));
+			m.w[i >> 6] |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(ok)) << (i & 63);
+		}
+		return m & all();
+	}
+
+	__attribute__((target("avx2")))
+	EntityMask	_range_kernel(const int* values, int min, int max) const
+	{
+		EntityMask	m(this);
+		const __m256i	vmin = _mm256_set1_epi32(min), vmax = _mm256_set1_epi32(max);
+		for (int i = 0; i < count; i += 8)
+		{
+			__m256i	v = _mm256_load_si256((const __m256i*)(values + i));
+			__m256i	out = _mm256_or_si256(_mm256_cmpgt_epi32(vmin, v), _mm256_cmpgt_epi32(v, vmax));
+			m.w[i >> 6] |= (uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF) << (i & 63);
+		}
+		return m & all();
+	}
+};
+
+inline Entity*	EntityMask::iterator::operator*() const { return _mask->world()->ref[_slot]; }
+
+//	Closed form earliest intercepts of every (hero, monster) pair of a World, in one pass per hero.
+//	A monster path is two straight segments : its current trajectory up to the turn it enters a base
+//	radius, then a straight run to that base. On each segment the first turn a hero starting at H can
+//	attack it is the smallest s >= 0 with |P(s) - H| <= HERO_SPEED * (s + 1) + HERO_ATTACK_RANGE,
+//	a quadratic in s. turns[h][slot] is the matrix of costs : the turn (1 = this turn) of the first
+//	possible attack, INTERCEPT_NONE if the monster hits a base or leaves the map before.
+class InterceptSolver
+{
+public:
+	InterceptSolver() : heroes(0), count(0) {}
+
+	alignas(32) int	turns[MAX_HEROES][WORLD_CAPACITY];
+	alignas(32) int	x[MAX_HEROES][WORLD_CAPACITY];	// Monster position at that turn, where to MOVE
+	alignas(32) int	y[MAX_HEROES][WORLD_CAPACITY];
+	int				heroes;
+	int				count;
+
+	Point	point(int h, int slot) const { return Point(x[h][slot], y[h][slot]); }
+	bool	reachable(int h, int slot) const { return turns[h][slot] < INTERCEPT_NONE; }
+
+	template<typename HeroContainer>
+	void	solve(const World& world, const HeroContainer& src_heroes, const Point (&bases)[2])
+	{
+		count = world.count;
+		for (int i = 0; i < count; ++i)
+			_path(world, i, bases);
+		for (int i = count; i < (count + 3) / 4 * 4; ++i)	// AVX2 tail lanes, as dead slots
+			_dead(i);
+		heroes = 0;
+		for (auto it = src_heroes.begin(); it != src_heroes.end() && heroes < MAX_HEROES; ++it)
+			_solve_hero(heroes++, it->xy);
+	}
+
+private:
+	//	Per slot path : segment 1 is o + w * s for s <= k, segment 2 is e + u * (s - k) for s >= k.
+	alignas(32) double	_ox[WORLD_CAPACITY];
+	alignas(32) double	_oy[WORLD_CAPACITY];
+	alignas(32) double	_wx[WORLD_CAPACITY];
+	alignas(32) double	_wy[WORLD_CAPACITY];
+	alignas(32) double	_k[WORLD_CAPACITY];
+	alignas(32) double	_ex[WORLD_CAPACITY];
+	alignas(32) double	_ey[WORLD_CAPACITY];
+	alignas(32) double	_ux[WORLD_CAPACITY];
+	alignas(32) double	_uy[WORLD_CAPACITY];
+	alignas(32) double	_end[WORLD_CAPACITY];	// last s the monster can still be attacked, < 0 for never
+
+	void	_dead(int i)
+	{
+		_ox[i] = _oy[i] = _wx[i] = _wy[i] = _k[i] = _ex[i] = _ey[i] = _ux[i] = _uy[i] = 0;
+		_end[i] = -1;
+	}
+
+	void	_path(const World& w, int i, const Point (&bases)[2])
+	{
+		_ox[i] = w.x[i];
+		_oy[i] = w.y[i];
+		_wx[i] = w.vx[i];
+		_wy[i] = w.vy[i];
+		if (w.fields[World::TYPE][i] != 0 || w.fields[World::HEALTH][i] <= 0)
+		{
+			_dead(i);
+			return;
+		}
+		//	Turn of the base radius entry (0 if already homing), or of the map exit.
+		int		target = -1;
+		double	k = ETA_HORIZON;
+		if (w.fields[World::NEAR_BASE][i] && w.fields[World::THREAT_FOR][i] > 0)
+		{
+			target = w.fields[World::THREAT_FOR][i] - 1;
+			k = 0;
+		}
+		else
+		{
+			k = std::min(_exit_turn(_ox[i], _wx[i], X_MAX, k), _exit_turn(_oy[i], _wy[i], Y_MAX, k));
+			double	leave = k;
+			for (int b = 0; b < 2; ++b)
+			{
+				double	dx = _ox[i] - bases[b].x, dy = _oy[i] - bases[b].y;
+				double	a = _wx[i] * _wx[i] + _wy[i] * _wy[i];
+				double	hb = dx * _wx[i] + dy * _wy[i];
+				double	c = dx * dx + dy * dy - (double)BASE_RADIUS * BASE_RADIUS;
+				double	disc = hb * hb - a * c;
+				if (a == 0 || hb >= 0 || disc < 0)
+					continue;
+				double	entry = std::max(0., std::ceil((-hb - std::sqrt(disc)) / a));
+				if (entry <= leave + 1 && (target < 0 || entry < k))	// targeting comes before the map exit removal
+				{
+					k = entry;
+					target = b;
+				}
+			}
+		}
+		_k[i] = k;
+		_ex[i] = _ox[i] + _wx[i] * k;
+		_ey[i] = _oy[i] + _wy[i] * k;
+		if (target < 0)
+		{
+			_ux[i] = _wx[i];
+			_uy[i] = _wy[i];
+			_end[i] = k;
+			return;
+		}
+		double	dx = bases[target].x - _ex[i], dy = bases[target].y - _ey[i];
+		double	d = std::sqrt(dx * dx + dy * dy);
+		_ux[i] = d > 0 ? dx * MONSTER_SPEED / d : 0;
+		_uy[i] = d > 0 ? dy * MONSTER_SPEED / d : 0;
+		//	Attacks are resolved before monster moves : the one reaching the base must be hit on the turn before.
+		_end[i] = k + std::max(0., std::ceil((d - BASE_DAMAGE_RADIUS) / MONSTER_SPEED)) - 1;
+	}
+
+	//	Last s with pos + v * s within [0, max], at most limit.
+	static double	_exit_turn(double pos, double v, int max, double limit)
+	{
+		if (v > 0)
+			return std::min(limit, std::floor((max - pos) / v));
+		if (v < 0)
+			return std::min(limit, std::floor(-pos / v));
+		return limit;
+	}
+
+	//	Smallest integer u >= 0 with |d + w * u| <= R * (u + g), R = HERO_SPEED = HERO_ATTACK_RANGE, 4 lanes.
+	__attribute__((target("avx2")))
+	static __m256d	_first_turn(__m256d dx, __m256d dy, __m256d wx, __m256d wy, __m256d g)
+	{
+		const __m256d	r2 = _mm256_set1_pd((double)HERO_SPEED * HERO_SPEED), zero = _mm256_setzero_pd();
+		__m256d	a = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(wx, wx), _mm256_mul_pd(wy, wy)), r2);	// < 0, monsters are slower than heroes
+		__m256d	hb = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(dx, wx), _mm256_mul_pd(dy, wy)), _mm256_mul_pd(r2, g));
+		__m256d	c = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+						_mm256_mul_pd(r2, _mm256_mul_pd(g, g)));
+		__m256d	disc = _mm256_max_pd(zero, _mm256_sub_pd(_mm256_mul_pd(hb, hb), _mm256_mul_pd(a, c)));
+		__m256d	u = _mm256_round_pd(_mm256_div_pd(_mm256_sub_pd(_mm256_sub_pd(zero, hb), _mm256_sqrt_pd(disc)), a),
+						_MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+		return _mm256_blendv_pd(u, zero, _mm256_cmp_pd(c, zero, _CMP_LE_OQ));
+	}
+
+	//	AVX2 through the target attribute, 4 slots per pass up to the tail lanes set by solve.
+	__attribute__((target("avx2")))
+	void	_solve_hero(int h, const Point& hero)
+	{
+		const __m256d	hx = _mm256_set1_pd(hero.x), hy = _mm256_set1_pd(hero.y);
+		const __m256d	two = _mm256_set1_pd(2), one = _mm256_set1_pd(1);
+		const __m256d	none = _mm256_set1_pd(INTERCEPT_NONE);
+		for (int i = 0; i < count; i += 4)
+		{
+			__m256d	ox = _mm256_load_pd(_ox + i), oy = _mm256_load_pd(_oy + i);
+			__m256d	wx = _mm256_load_pd(_wx + i), wy = _mm256_load_pd(_wy + i);
+			__m256d	ex = _mm256_load_pd(_ex + i), ey = _mm256_load_pd(_ey + i);
+			__m256d	ux = _mm256_load_pd(_ux + i), uy = _mm256_load_pd(_uy + i);
+			__m256d	k = _mm256_load_pd(_k + i);
+			__m256d	s1 = _first_turn(_mm256_sub_pd(ox, hx), _mm256_sub_pd(oy, hy), wx, wy, two);
+			__m256d	u2 = _first_turn(_mm256_sub_pd(ex, hx), _mm256_sub_pd(ey, hy), ux, uy, _mm256_add_pd(k, two));
+			__m256d	on1 = _mm256_cmp_pd(s1, k, _CMP_LE_OQ);
+			__m256d	s = _mm256_blendv_pd(_mm256_add_pd(k, u2), s1, on1);
+			__m256d	px = _mm256_blendv_pd(_mm256_add_pd(ex, _mm256_mul_pd(ux, u2)), _mm256_add_pd(ox, _mm256_mul_pd(wx, s1)), on1);
+			__m256d	py = _mm256_blendv_pd(_mm256_add_pd(ey, _mm256_mul_pd(uy, u2)), _mm256_add_pd(oy, _mm256_mul_pd(wy, s1)), on1);
+			__m256d	ok = _mm256_cmp_pd(s, _mm256_load_pd(_end + i), _CMP_LE_OQ);
+			s = _mm256_blendv_pd(none, _mm256_add_pd(s, one), ok);
+			_mm_store_si128((__m128i*)(turns[h] + i), _mm256_cvttpd_epi32(s));
+			_mm_store_si128((__m128i*)(x[h] + i), _mm256_cvttpd_epi32(px));
+			_mm_store_si128((__m128i*)(y[h] + i), _mm256_cvttpd_epi32(py));
+		}
+	}
+};
+
+//	Scores WIND_DIRECTIONS wind directions for a hero at once : every unshielded monster within WIND_RANGE
+//	is pushed by WIND_PUSH (clamped to the map), and a direction scores the threat it removes from our
+//	base plus the threat it adds to the opponent one. The threat of a monster at p for base b is
+//	health * max(0, BASE_VISION - dist(p, b)). SIMD lanes run over the directions.
+class WindSweep
+{
+public:
+	WindSweep()
+	{
+		for (int k = 0; k < WIND_DIRECTIONS; ++k)
+		{
+			Vect push = Vect::polar(WIND_PUSH, k * (TRIG_STEPS / WIND_DIRECTIONS));
+			_dx[k] = push.x;
+			_dy[k] = push.y;
+		}
+	}
+
+	alignas(32) float	scores[WIND_DIRECTIONS];	// Of the last sweep
+	int					targets;
+
+	//	Best direction for a hero (-1 without target), scores[] holds every direction score.
+	int		sweep(const World& world, const Point& hero, const Point (&bases)[2])
+	{
+		EntityMask	m(world.in_range(hero, WIND_RANGE) & world.match(World::TYPE, 0) & world.match(World::SHIELD_LIFE, 0));
+		float		base_score = 0;
+		targets = 0;
+		for (int k = 0; k < WIND_DIRECTIONS; ++k)
+			scores[k] = 0;
+		for (auto it = m.begin(); it != m.end(); ++it)
+		{
+			int		i = it.slot();
+			float	x = world.x[i], y = world.y[i], hp = world.fields[World::HEALTH][i];
+			base_score += hp * (_threat(x, y, bases[0]) - _threat(x, y, bases[1]));
+			_accumulate(x, y, hp, bases);
+			++targets;
+		}
+		if (!targets)
+			return -1;
+		int	best = 0;
+		for (int k = 0; k < WIND_DIRECTIONS; ++k)
+		{
+			scores[k] += base_score;
+			if (scores[k] > scores[best])
+				best = k;
+		}
+		return best;
+	}
+
+	Vect	push(int k) const { return Vect((int)_dx[k], (int)_dy[k]); }
+
+private:
+	alignas(32) float	_dx[WIND_DIRECTIONS];
+	alignas(32) float	_dy[WIND_DIRECTIONS];
+
+	static float	_threat(float x, float y, const Point& b)
+	{
+		float d = std::sqrt((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y));
+		return std::max(0.f, BASE_VISION - d);
+	}
+
+	//	Same as _threat, 8 lanes.
+	__attribute__((target("avx2")))
+	static __m256	_threat(__m256 px, __m256 py, __m256 bx, __m256 by)
+	{
+		__m256	dx = _mm256_sub_ps(px, bx), dy = _mm256_sub_ps(py, by);
+		__m256	d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+		return _mm256_max_ps(_mm256_setzero_ps(), _mm256_sub_ps(_mm256_set1_ps(BASE_VISION), d));
+	}
+
+	//	scores[k] += hp * (threat of the pushed position for the opponent - for us).
+	//	AVX2 through the target attribute, 8 directions per pass.
+	__attribute__((target("avx2")))
+	void	_accumulate(float x, float y, float hp, const Point (&bases)[2])
+	{
+		const __m256	vx = _mm256_set1_ps(x), vy = _mm256_set1_ps(y), vhp = _mm256_set1_ps(hp);
+		const __m256	zero = _mm256_setzero_ps(), xmax = _mm256_set1_ps(X_MAX), ymax = _mm256_set1_ps(Y_MAX);
+		const __m256	b0x = _mm256_set1_ps(bases[0].x), b0y = _mm256_set1_ps(bases[0].y);
+		const __m256	b1x = _mm256_set1_ps(bases[1].x), b1y = _mm256_set1_ps(bases[1].y);
+		for (int k = 0; k < WIND_DIRECTIONS; k += 8)
+		{
+			__m256	px = _mm256_min_ps(xmax, _mm256_max_ps(zero, _mm256_add_ps(vx, _mm256_load_ps(_dx + k))));
+			__m256	py = _mm256_min_ps(ymax, _mm256_max_ps(zero, _mm256_add_ps(vy, _mm256_load_ps(_dy + k))));
+			__m256	gain = _mm256_sub_ps(_threat(px, py, b1x, b1y), _threat(px, py, b0x, b0y));
+			_mm256_store_ps(scores + k, _mm256_add_ps(_mm256_load_ps(scores + k), _mm256_mul_ps(vhp, gain)));
+		}
+	}
+};
+
+//	Min cost assignment of at most MAX_HEROES heroes to distinct tasks, some of them spells sharing a mana
+//	budget. Dynamic programming over the tasks, with the set of busy heroes and the spells count as state :
+//	(MAX_TASKS + 1) * 2^MAX_HEROES * (MAX_HEROES + 1) cells, no allocation.
+class Assignment
+{
+public:
+	Assignment() : heroes(0), tasks(0) {}
+
+	int		cost[MAX_HEROES][MAX_TASKS];	// ASSIGN_NONE when the hero cannot take the task
+	bool	spell[MAX_TASKS];
+	int		heroes;
+	int		tasks;
+
+	void	reset(int heroes_count)
+	{
+		heroes = std::min(heroes_count, MAX_HEROES);
+		tasks = 0;
+	}
+	//	New task, forbidden to every hero until its costs are set. -1 when full.
+	int		add(bool is_spell)
 	{
+		if (tasks == MAX_TASKS)
+			return -1;
+		for (int h = 0; h < MAX_HEROES; ++h)
+			cost[h][tasks] = ASSIGN_NONE;
+		spell[tasks] = is_spell;
+		return tasks++;
+	}
+
+	//	Every hero gets a task (task[h]), with at most max_spells spells. Returns the total cost,
+	//	ASSIGN_NONE if there is no complete assignment.
+	int		solve(int max_spells, int (&task)[MAX_HEROES])
+	{
+		const int	full = (1 << heroes) - 1;
+		max_spells = std::max(0, std::min(max_spells, MAX_HEROES));
+		for (int mask = 0; mask <= full; ++mask)
+			for (int sp = 0; sp <= MAX_HEROES; ++sp)
+				_best[0][mask][sp] = mask || sp ? ASSIGN_NONE : 0;
+		for (int t = 0; t < tasks; ++t)
+			for (int mask = 0; mask <= full; ++mask)
+				for (int sp = 0; sp <= max_spells; ++sp)
+				{
+					int	best = _best[t][mask][sp];
+					int	who = -1;
+					int	prev_sp = sp - spell[t];
+					for (int h = 0; prev_sp >= 0 && h < heroes; ++h)
+					{
+						if (!(mask >> h & 1) || cost[h][t] >= ASSIGN_NONE)
+							continue;
+						int	c = _best[t][mask ^ (1 << h)][prev_sp];
+						if (c < ASSIGN_NONE && c + cost[h][t] < best)
+						{
+							best = c + cost[h][t];
+							who = h;
+						}
+					}
+					_best[t + 1][mask][sp] = best;
+					_who[t + 1][mask][sp] = who;
+				}
+
+		int	sp = 0;
+		for (int s = 1; s <= max_spells; ++s)
+			if (_best[tasks][full][s] < _best[tasks][full][sp])
+				sp = s;
+		int	total = _best[tasks][full][sp];
+		for (int h = 0; h < MAX_HEROES; ++h)
+			task[h] = -1;
+		if (total >= ASSIGN_NONE)
+			return ASSIGN_NONE;
+		for (int t = tasks, mask = full; t > 0; --t)
+		{
+			int	h = _who[t][mask][sp];
+			if (h < 0)
+				continue;
+			task[h] = t - 1;
+			mask ^= 1 << h;
+			sp -= spell[t - 1];
+		}
+		return total;
+	}
+
+private:
+	int			_best[MAX_TASKS + 1][1 << MAX_HEROES][MAX_HEROES + 1];
+	int8_t		_who[MAX_TASKS + 1][1 << MAX_HEROES][MAX_HEROES + 1];	// hero taking task t - 1, -1 if none
+};
+
+static const std::map<std::string, int Entity::*> EntityIntMembers = {
+	{"id", &Entity::id},
+	{"type", &Entity::type},
+	{"shield_life", &Entity::shield_life},
+	{"is_controlled", &Entity::is_controlled},
+	{"health", &Entity::health},
+	{"near_base", &Entity::near_base},
+	{"threat_for", &Entity::threat_for}
+};
+
+class EntityCompare		// Gereric virtual binary predicate on entities or pointer on entities.
+{
+public:
+	virtual bool	operator()(const Entity& a, const Entity& b) const final { return compared_value(a) < compared_value(b); };
+	virtual	bool	operator()(const Entity* a, const Entity* b) const final { return compared_value(*a) < compared_value(*b); };
+	virtual	int		compared_value(const Entity& e) const { return e.id; }
+};
+
+class EntityMemberCompare : public EntityCompare	// Binary predicate comparing int members of two entities.
+{
+public:
+	EntityMemberCompare(const std::string& member) {
 		auto f = EntityIntMembers.find(member);
 		if (f != EntityIntMembers.end())
-			return f->second;
+			_ptr_m = f->second;
 		else
-			return &Entity::id;
+			_ptr_m = &Entity::id;
 	}
-	int Entity::*			_ptr_m;
+	virtual	int		compared_value(const Entity& e) const { return e.*_ptr_m; }
+private:
+	int Entity::* _ptr_m;
 };
 
-class EntityDistSelect : public EntitySelect		// Unnary predicate selecting entities on a distance to a given reference point.
+class EntityDistCompare : public EntityCompare		// Binary predicate comparing entities distance to a given reference point.
 {
 public:
-	EntityDistSelect(const Point& ref_point, int max) : _ref(ref_point), EntitySelect(max) {}
-	EntityDistSelect(const Point& ref_point, int min, int max) : _ref(ref_point), EntitySelect(min, max) {}
-	EntityDistSelect(const Point& ref_point, const std::initializer_list<int>& values) : _ref(ref_point), EntitySelect(values) {}
-	EntityDistSelect(const Point& ref_point, std::initializer_list<int>&& values) : _ref(ref_point), EntitySelect(std::move(values)) {}
-	EntityDistSelect(Point&& ref_point, int max) : _ref(std::move(ref_point)), EntitySelect(max) {}
-	EntityDistSelect(Point&& ref_point, int min, int max) : _ref(std::move(ref_point)), EntitySelect(min, max) {}
-	EntityDistSelect(Point&& ref_point, const std::initializer_list<int>& values) : _ref(std::move(ref_point)), EntitySelect(values) {}
-	EntityDistSelect(Point&& ref_point, std::initializer_list<int>&& values) : _ref(std::move(ref_point)), EntitySelect(std::move(values)) {}
-	virtual	int				selected_value(const Entity& e) const { return e.xy.dist(_ref); }
+	EntityDistCompare(const Point& ref_point) : p(ref_point) {}
+	EntityDistCompare(Point&& ref_point) : p(std::move(ref_point)) {}
+	virtual	int		compared_value(const Entity& e) const { return e.xy.dist(p); }
 private:
-	const Point				_ref;
+	const Point p;
 };
 
-class EntityDestSelect : public EntitySelect		// Unnary predicate selecting entities on a distance to a given reference point.
+class EntityDestCompare : public EntityCompare		// Binary predicate comparing entities distance to a given reference point.
 {
 public:
-	EntityDestSelect(const Point& ref_point, int max) : _ref(ref_point), EntitySelect(max) {}
-	EntityDestSelect(const Point& ref_point, int min, int max) : _ref(ref_point), EntitySelect(min, max) {}
-	EntityDestSelect(const Point& ref_point, const std::initializer_list<int>& values) : _ref(ref_point), EntitySelect(values) {}
-	EntityDestSelect(const Point& ref_point, std::initializer_list<int>&& values) : _ref(ref_point), EntitySelect(std::move(values)) {}
-	EntityDestSelect(Point&& ref_point, int max) : _ref(std::move(ref_point)), EntitySelect(max) {}
-	EntityDestSelect(Point&& ref_point, int min, int max) : _ref(std::move(ref_point)), EntitySelect(min, max) {}
-	EntityDestSelect(Point&& ref_point, const std::initializer_list<int>& values) : _ref(std::move(ref_point)), EntitySelect(values) {}
-	EntityDestSelect(Point&& ref_point, std::initializer_list<int>&& values) : _ref(std::move(ref_point)), EntitySelect(std::move(values)) {}
-	virtual	int				selected_value(const Entity& e) const { return e.dst.dist(_ref); }
+	EntityDestCompare(const Point& ref_point) : p(ref_point) {}
+	EntityDestCompare(Point&& ref_point) : p(std::move(ref_point)) {}
+	virtual	int		compared_value(const Entity& e) const { return e.dst.dist(p); }
+private:
+	const Point p;
+};
+
+class EntityAngleCompare : public EntityCompare		// Binary predicate comparing entities direction vector angle (as Vect::angle_key) to a given reference vector.
+{
+public:
+	EntityAngleCompare(const Vect& ref_vect) : v(ref_vect) {}
+	EntityAngleCompare(Vect&& ref_vect) : v(std::move(ref_vect)) {}
+	virtual	int		compared_value(const Entity& e) const { return e.vxy.angle_key(v); }
+private:
+	const Vect v;
+};
+
+class EntitySelect		// Gereric virtual unary predicate on entities or pointer on entities.
+{
+public:
+	EntitySelect(int max) : _mode(0), _max(max) {}
+	EntitySelect(int min, int max) : _mode(1), _min(min), _max(max) {}
+	EntitySelect(const std::initializer_list<int>& values) : _mode(2) { _copy_values(values); }
+	EntitySelect(std::initializer_list<int>&& values) : _mode(2) { _copy_values(values); }
+	virtual	int		selected_value(const Entity& e) const = 0;
+
+	virtual bool	operator()(const Entity* e) const final { return selected(*e); }
+	virtual bool	operator()(const Entity& e) const final { return selected(e); }
+protected:
+	virtual bool	selected(const Entity& e) const
+	{
+		switch(_mode)
+		{
+			case 0:		return selected_value(e) <= _max;
+			case 1:		return _min <= selected_value(e) && selected_value(e) <= _max;
+			case 2:		return std::find(_values.begin(), _values.end(), selected_value(e)) != _values.end();
+			default:	return false;
+		}
+	}
+	//	Range modes on a distance, with squared bounds and no sqrt.
+	bool			selected_dist(const Entity& e, const Point& a, const Point& b) const
+	{
+		switch(_mode)
+		{
+			case 0:		return a.in_range(b, _max);
+			case 1:		return (_min <= 0 || (int64_t)_min * _min <= a.dist2(b)) && a.in_range(b, _max);
+			default:	return EntitySelect::selected(e);
+		}
+	}
+private:
+	//	Values are copied : an initializer_list backing array dies with the full expression.
+	void						_copy_values(const std::initializer_list<int>& values) { _values.assign(values.begin(), values.end()); }
+
+	int							_mode;
+	std::vector<int>			_values;
+	int 						_min;
+	int 						_max;
+};
+
+class EntityMemberSelect : public EntitySelect		// Unnary predicate selecting entities on a member value.
+{
+public:
+	EntityMemberSelect(const std::string& member, int max) : _ptr_m(_init_ptr(member)), EntitySelect(max) {}
+	EntityMemberSelect(const std::string& member, int min, int max) : _ptr_m(_init_ptr(member)), EntitySelect(min, max) {}
+	EntityMemberSelect(const std::string& member, const std::initializer_list<int>& values) : _ptr_m(_init_ptr(member)), EntitySelect(values) {}
+	EntityMemberSelect(const std::string& member, std::initializer_list<int>&& values) : _ptr_m(_init_ptr(member)), EntitySelect(std::move(values)) {}
+	virtual	int				selected_value(const Entity& e) const { return e.*_ptr_m; }
+private:
+	static int Entity::*	_init_ptr(const std::string& member)
+	{
+		auto f = EntityIntMembers.find(member);
+		if (f != EntityIntMembers.end())
+			return f->second;
+		else
+			return &Entity::id;
+	}
+	int Entity::*			_ptr_m;
+};
+
+class EntityDistSelect : public EntitySelect		// Unnary predicate selecting entities on a distance to a given reference point.
+{
+public:
+	EntityDistSelect(const Point& ref_point, int max) : _ref(ref_point), EntitySelect(max) {}
+	EntityDistSelect(const Point& ref_point, int min, int max) : _ref(ref_point), EntitySelect(min, max) {}
+	EntityDistSelect(const Point& ref_point, const std::initializer_list<int>& values) : _ref(ref_point), EntitySelect(values) {}
+	EntityDistSelect(const Point& ref_point, std::initializer_list<int>&& values) : _ref(ref_point), EntitySelect(std::move(values)) {}
+	EntityDistSelect(Point&& ref_point, int max) : _ref(std::move(ref_point)), EntitySelect(max) {}
+	EntityDistSelect(Point&& ref_point, int min, int max) : _ref(std::move(ref_point)), EntitySelect(min, max) {}
+	EntityDistSelect(Point&& ref_point, const std::initializer_list<int>& values) : _ref(std::move(ref_point)), EntitySelect(values) {}
+	EntityDistSelect(Point&& ref_point, std::initializer_list<int>&& values) : _ref(std::move(ref_point)), EntitySelect(std::move(values)) {}
+	virtual	int				selected_value(const Entity& e) const { return e.xy.dist(_ref); }
+protected:
+	virtual bool			selected(const Entity& e) const { return selected_dist(e, e.xy, _ref); }
+private:
+	const Point				_ref;
+};
+
+class EntityDestSelect : public EntitySelect		// Unnary predicate selecting entities on a distance to a given reference point.
+{
+public:
+	EntityDestSelect(const Point& ref_point, int max) : _ref(ref_point), EntitySelect(max) {}
+	EntityDestSelect(const Point& ref_point, int min, int max) : _ref(ref_point), EntitySelect(min, max) {}
+	EntityDestSelect(const Point& ref_point, const std::initializer_list<int>& values) : _ref(ref_point), EntitySelect(values) {}
+	EntityDestSelect(const Point& ref_point, std::initializer_list<int>&& values) : _ref(ref_point), EntitySelect(std::move(values)) {}
+	EntityDestSelect(Point&& ref_point, int max) : _ref(std::move(ref_point)), EntitySelect(max) {}
+	EntityDestSelect(Point&& ref_point, int min, int max) : _ref(std::move(ref_point)), EntitySelect(min, max) {}
+	EntityDestSelect(Point&& ref_point, const std::initializer_list<int>& values) : _ref(std::move(ref_point)), EntitySelect(values) {}
+	EntityDestSelect(Point&& ref_point, std::initializer_list<int>&& values) : _ref(std::move(ref_point)), EntitySelect(std::move(values)) {}
+	virtual	int				selected_value(const Entity& e) const { return e.dst.dist(_ref); }
+protected:
+	virtual bool			selected(const Entity& e) const { return selected_dist(e, e.dst, _ref); }
+private:
+	const Point				_ref;
+};
+
+class EntityAngleSelect : public EntitySelect		// Unnary predicate selecting entities on an angle to a given reference vector.
+{
+public:
+	EntityAngleSelect(const Vect& ref_vect, int max) : _ref(ref_vect), EntitySelect(max) {}
+	EntityAngleSelect(const Vect& ref_vect, int min, int max) : _ref(ref_vect), EntitySelect(min, max) {}
+	EntityAngleSelect(const Vect& ref_vect, const std::initializer_list<int>& values) : _ref(ref_vect), EntitySelect(values) {}
+	EntityAngleSelect(const Vect& ref_vect, std::initializer_list<int>&& values) : _ref(ref_vect), EntitySelect(std::move(values)) {}
+	EntityAngleSelect(Vect&& ref_vect, int max) : _ref(std::move(ref_vect)), EntitySelect(max) {}
+	EntityAngleSelect(Vect&& ref_vect, int min, int max) : _ref(std::move(ref_vect)), EntitySelect(min, max) {}
+	EntityAngleSelect(Vect&& ref_vect, const std::initializer_list<int>& values) : _ref(std::move(ref_vect)), EntitySelect(values) {}
+	EntityAngleSelect(Vect&& ref_vect, std::initializer_list<int>&& values) : _ref(std::move(ref_vect)), EntitySelect(std::move(values)) {}
+	virtual	int				selected_value(const Entity& e) const { return e.vxy.angle(_ref); }
+private:
+	const Vect				_ref;
+};
+
+
+//	Compile time entity expressions, an inlinable alternative to EntityCompare / EntitySelect.
+//	Keys are int valued (member<&Entity::health>, dist_to(p), dest_dist_to(p), angle_to(v)),
+//	comparing a key with an int gives a predicate, and predicates compose with &&, || and !.
+//		Remap::create_set(by(dist_to(base.xy)), member<&Entity::threat_for> == 1 && dist_to(p) <= 2200, monsters);
+struct EntityPredTag {};
+
+template<typename Derived>
+struct EntityKey
+{
+	const Derived&	self() const { return static_cast<const Derived&>(*this); }
+	int				operator()(const Entity& e) const { return self().value(e); }
+	int				operator()(const Entity* e) const { return self().value(*e); }
+};
+
+template<typename Derived>
+struct EntityPred : EntityPredTag
+{
+	const Derived&	self() const { return static_cast<const Derived&>(*this); }
+	bool			operator()(const Entity& e) const { return self().test(e); }
+	bool			operator()(const Entity* e) const { return self().test(*e); }
+};
+
+template<typename T>
+struct is_entity_pred : std::is_base_of<EntityPredTag, T> {};
+
+template<typename... Ts>
+struct any_entity_pred : std::false_type {};
+template<typename T, typename... Ts>
+struct any_entity_pred<T, Ts...> : std::integral_constant<bool, is_entity_pred<T>::value || any_entity_pred<Ts...>::value> {};
+
+//	Disables unfiltered overloads when a predicate lvalue would be taken for a container.
+template<typename... Containers>
+using no_entity_pred = typename std::enable_if<!any_entity_pred<Containers...>::value>::type;
+
+template<int Entity::* M>
+struct MemberKey : EntityKey<MemberKey<M>>	//	Int member value.
+{
+	int		value(const Entity& e) const { return e.*M; }
+};
+template<int Entity::* M>
+constexpr MemberKey<M>	member{};
+
+struct DistKey : EntityKey<DistKey>		//	Distance from entity position to a reference point.
+{
+	DistKey(const Point& ref) : ref(ref) {}
+	int		value(const Entity& e) const { return e.xy.dist(ref); }
+	Point	ref;
+};
+inline DistKey		dist_to(const Point& ref) { return DistKey(ref); }
+
+struct DestKey : EntityKey<DestKey>		//	Distance from entity next turn destination to a reference point.
+{
+	DestKey(const Point& ref) : ref(ref) {}
+	int		value(const Entity& e) const { return e.dst.dist(ref); }
+	Point	ref;
+};
+inline DestKey		dest_dist_to(const Point& ref) { return DestKey(ref); }
+
+struct AngleKey : EntityKey<AngleKey>	//	Angle between entity trajectory and a reference vector, as Vect::angle_key.
+{
+	AngleKey(const Vect& ref) : ref(ref) {}
+	int		value(const Entity& e) const { return e.vxy.angle_key(ref); }
+	Vect	ref;
+};
+inline AngleKey		angle_to(const Vect& ref) { return AngleKey(ref); }
+
+template<typename Key, typename Op>
+struct KeyCmpPred : EntityPred<KeyCmpPred<Key, Op>>	//	key <op> n
+{
+	KeyCmpPred(const Key& key, int n) : key(key), n(n) {}
+	bool	test(const Entity& e) const { return Op()(key.value(e), n); }
+	Key		key;
+	int		n;
+};
+
+//	Distance upper bounds are tested on squared distances (same truncated semantic as Point::dist).
+template<>
+struct KeyCmpPred<DistKey, std::less_equal<int>> : EntityPred<KeyCmpPred<DistKey, std::less_equal<int>>>
+{
+	KeyCmpPred(const DistKey& key, int n) : key(key), n(n) {}
+	bool	test(const Entity& e) const { return e.xy.in_range(key.ref, n); }
+	DistKey	key;
+	int		n;
+};
+template<>
+struct KeyCmpPred<DestKey, std::less_equal<int>> : EntityPred<KeyCmpPred<DestKey, std::less_equal<int>>>
+{
+	KeyCmpPred(const DestKey& key, int n) : key(key), n(n) {}
+	bool	test(const Entity& e) const { return e.dst.in_range(key.ref, n); }
+	DestKey	key;
+	int		n;
+};
+
+template<typename Key>
+struct KeyRangePred : EntityPred<KeyRangePred<Key>>	//	min <= key <= max
+{
+	KeyRangePred(const Key& key, int min, int max) : key(key), min(min), max(max) {}
+	bool	test(const Entity& e) const { int v = key.value(e); return min <= v && v <= max; }
+	Key		key;
+	int		min;
+	int		max;
+};
+
+template<typename Key, int N>
+struct KeyInPred : EntityPred<KeyInPred<Key, N>>	//	key is one of N values (stored by value)
+{
+	bool	test(const Entity& e) const
+	{
+		int v = key.value(e);
+		for (int i = 0; i < N; ++i)
+			if (values[i] == v)
+				return true;
+		return false;
+	}
+	Key		key;
+	int		values[N];
+};
+
+template<typename A, typename B>
+struct AndPred : EntityPred<AndPred<A, B>>
+{
+	AndPred(const A& a, const B& b) : a(a), b(b) {}
+	bool	test(const Entity& e) const { return a.test(e) && b.test(e); }
+	A		a;
+	B		b;
+};
+
+template<typename A, typename B>
+struct OrPred : EntityPred<OrPred<A, B>>
+{
+	OrPred(const A& a, const B& b) : a(a), b(b) {}
+	bool	test(const Entity& e) const { return a.test(e) || b.test(e); }
+	A		a;
+	B		b;
+};
+
+template<typename A>
+struct NotPred : EntityPred<NotPred<A>>
+{
+	NotPred(const A& a) : a(a) {}
+	bool	test(const Entity& e) const { return !a.test(e); }
+	A		a;
+};
+
+struct AnyPred : EntityPred<AnyPred>	//	Selects everything.
+{
+	bool	test(const Entity&) const { return true; }
+};
+
+template<typename K> KeyCmpPred<K, std::less_equal<int>>	operator<=(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+template<typename K> KeyCmpPred<K, std::less<int>>			operator<(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+template<typename K> KeyCmpPred<K, std::greater_equal<int>>	operator>=(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+template<typename K> KeyCmpPred<K, std::greater<int>>		operator>(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+template<typename K> KeyCmpPred<K, std::equal_to<int>>		operator==(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+template<typename K> KeyCmpPred<K, std::not_equal_to<int>>	operator!=(const EntityKey<K>& k, int n) { return {k.self(), n}; }
+
+template<typename K>
+KeyRangePred<K>		between(const EntityKey<K>& k, int min, int max) { return KeyRangePred<K>(k.self(), min, max); }
+
+template<typename K, typename... Values>
+KeyInPred<K, sizeof...(Values)>	one_of(const EntityKey<K>& k, Values... values)
+{
+	return KeyInPred<K, sizeof...(Values)>{{}, k.self(), {values...}};
+}
+
+template<typename A, typename B>
+AndPred<A, B>	operator&&(const EntityPred<A>& a, const EntityPred<B>& b) { return AndPred<A, B>(a.self(), b.self()); }
+template<typename A, typename B>
+OrPred<A, B>	operator||(const EntityPred<A>& a, const EntityPred<B>& b) { return OrPred<A, B>(a.self(), b.self()); }
+template<typename A>
+NotPred<A>		operator!(const EntityPred<A>& a) { return NotPred<A>(a.self()); }
+
+template<typename Key>
+struct KeyLess	//	Binary predicate ordering entities (or pointers) on a key, by(key) builds it.
+{
+	KeyLess(const Key& key) : key(key) {}
+	bool	operator()(const Entity& a, const Entity& b) const { return key.value(a) < key.value(b); }
+	bool	operator()(const Entity* a, const Entity* b) const { return key.value(*a) < key.value(*b); }
+	int		compared_value(const Entity& e) const { return key.value(e); }
+	Key		key;
+};
+template<typename K>
+KeyLess<K>		by(const EntityKey<K>& k) { return KeyLess<K>(k.self()); }
+
+//	Bump allocator for per turn scratch memory, reset at the top of the game loop.
+//	Blocks are kept across resets, so once warmed up a turn never reaches malloc.
+class Arena
+{
+public:
+	Arena(size_t block_size = 1 << 16) : _block_size(block_size), _block(0), _used(0) {}
+	Arena(const Arena&) = delete;
+	Arena&	operator=(const Arena&) = delete;
+	~Arena()
+	{
+		for (auto it = _blocks.begin(); it != _blocks.end(); ++it)
+			delete[] it->first;
+	}
+
+	template<typename T>
+	T*		alloc(size_t n)
+	{
+		const size_t	bytes = n * sizeof(T);
+		for (;;)
+		{
+			if (_block == _blocks.size())
+			{
+				size_t size = std::max(_block_size, bytes + alignof(T));
+				_blocks.push_back(std::make_pair(new char[size], size));
+			}
+			size_t offset = (_used + alignof(T) - 1) & ~(alignof(T) - 1);
+			if (offset + bytes <= _blocks[_block].second)
+			{
+				_used = offset + bytes;
+				return reinterpret_cast<T*>(_blocks[_block].first + offset);
+			}
+			++_block;
+			_used = 0;
+		}
+	}
+	void	reset() { _block = 0; _used = 0; }
+	size_t	blocks() const { return _blocks.size(); }
+
+private:
+	size_t								_block_size;
+	std::vector<std::pair<char*, size_t>>	_blocks;
+	size_t								_block;
+	size_t								_used;
+};
+
+struct EntityViewItem
+{
+	int		key;	// Key computed once at insertion
+	int		seq;	// Insertion order, keeps equal keys in insertion order
+	Entity*	e;
+
+	bool	operator<(const EntityViewItem& rhs) const { return key < rhs.key || (key == rhs.key && seq < rhs.seq); }
+};
+
+class EntityViewIterator
+{
+public:
+	explicit EntityViewIterator(const EntityViewItem* it) : _it(it) {}
+	Entity*				operator*() const { return _it->e; }
+	EntityViewIterator&	operator++() { ++_it; return *this; }
+	bool				operator==(const EntityViewIterator& rhs) const { return _it == rhs._it; }
+	bool				operator!=(const EntityViewIterator& rhs) const { return _it != rhs._it; }
+	int					key() const { return _it->key; }
+private:
+	const EntityViewItem*	_it;
+};
+
+//	Flat arena backed multiset of entity pointers, ordered on a key.
+//	Sorting is lazy : only begin() sorts, min() is a linear scan and sort_first() a partial sort.
+template<typename Key>
+class EntityView
+{
+public:
+	typedef EntityViewIterator	iterator;
+
+	EntityView(const KeyLess<Key>& cmp, Arena& arena, int capacity)
+		: _cmp(cmp), _arena(&arena), _items(arena.alloc<EntityViewItem>(capacity)),
+		_size(0), _capacity(capacity), _seq(0), _sorted(true) {}
+
+	int			size() const { return _size; }
+	bool		empty() const { return !_size; }
+	iterator	begin() const { _sort(); return iterator(_items); }
+	iterator	end() const { return iterator(_items + _size); }
+	iterator	unsorted_begin() const { return iterator(_items); }
+
+	//	Smallest key entity (first inserted on ties) or nullptr, without sorting.
+	Entity*		min() const
+	{
+		if (!_size)
+			return nullptr;
+		return _sorted ? _items[0].e : std::min_element(_items, _items + _size)->e;
+	}
+	//	Orders only the k smallest entities at the front of the view.
+	void		sort_first(int k) const
+	{
+		if (k >= _size)
+			_sort();
+		else if (!_sorted)
+			std::partial_sort(_items, _items + k, _items + _size);
+	}
+
+	void		insert(Entity* e)
+	{
+		if (_size == _capacity)
+			_grow();
+		_items[_size] = EntityViewItem{_cmp.compared_value(*e), _seq++, e};
+		_sorted = _sorted && (!_size || !(_items[_size] < _items[_size - 1]));
+		++_size;
+	}
+
+	const KeyLess<Key>&	key_comp() const { return _cmp; }
+
+private:
+	void		_grow()
+	{
+		int				capacity = std::max(8, _capacity * 2);
+		EntityViewItem*	items = _arena->alloc<EntityViewItem>(capacity);
+		std::copy(_items, _items + _size, items);
+		_items = items;
+		_capacity = capacity;
+	}
+	void		_sort() const
+	{
+		if (!_sorted)
+			std::sort(_items, _items + _size);
+		_sorted = true;
+	}
+
+	KeyLess<Key>	_cmp;
+	Arena*			_arena;
+	EntityViewItem*	_items;
+	int				_size;
+	int				_capacity;
+	int				_seq;
+	mutable bool	_sorted;
+};
+
+//	Utility class for remapping entities pointer including sorting and selection.
+class Remap
+{
+public:
+	//	Scratch memory of the flat views, to reset once per turn.
+	static Arena&	arena()
+	{
+		static thread_local Arena	turn_arena;	// one per thread for the local referee games
+		return turn_arena;
+	}
+
+	template<typename Key, typename... Containers, typename = no_entity_pred<Containers...>>
+	static EntityView<Key>	create_set(const KeyLess<Key>& cmp, Containers&... src_containers)
+	{
+		PROFILE_SCOPE(PROF_REMAP);
+		PROFILE_COUNT(PROF_SETS, 1);
+		EntityView<Key>	set(cmp, arena(), _capacity(src_containers...));
+		add_to_set(set, src_containers...);
+		return set;
+	}
+	template<typename Key, typename Pred, typename... Containers>
+	static EntityView<Key>	create_set(const KeyLess<Key>& cmp, const EntityPred<Pred>& sel, Containers&... src_containers)
+	{
+		PROFILE_SCOPE(PROF_REMAP);
+		PROFILE_COUNT(PROF_SETS, 1);
+		EntityView<Key>	set(cmp, arena(), _capacity(src_containers...));
+		add_to_set(set, sel, src_containers...);
+		return set;
+	}
+	template<typename Set, typename... Containers, typename = no_entity_pred<Containers...>>
+	static void add_to_set(Set& set, Containers&... src_containers)
+	{
+		(void)std::initializer_list<int>{(_int_add_to_set(set, src_containers), 0)...};
+	}
+	template<typename Set, typename... Containers>
+	static void add_to_set(Set& set, const EntitySelect& sel, Containers&... src_containers)
+	{
+		(void)std::initializer_list<int>{(_int_add_to_set(set, sel, src_containers), 0)...};
+	}
+	template<typename Set, typename Pred, typename... Containers>
+	static void add_to_set(Set& set, const EntityPred<Pred>& sel, Containers&... src_containers)
+	{
+		(void)std::initializer_list<int>{(_int_add_to_set(set, sel.self(), src_containers), 0)...};
+	}
+	//	Short-circuit queries, nothing is stored nor sorted.
+	template<typename Pred, typename... Containers>
+	static int	count(const EntityPred<Pred>& sel, Containers&... src_containers)
+	{
+		int n = 0;
+		(void)std::initializer_list<int>{(n += _int_count(sel.self(), src_containers), 0)...};
+		return n;
+	}
+	template<typename Pred, typename... Containers>
+	static bool	any(const EntityPred<Pred>& sel, Containers&... src_containers)
+	{
+		bool found = false;
+		(void)std::initializer_list<int>{(found = found || _int_any(sel.self(), src_containers), 0)...};
+		return found;
+	}
+	template<typename Set>
+	static int	compared_value(const Set& set, const Entity& e) { return set.key_comp().compared_value(e); }
+	template<typename Set>
+	static int	compared_value(const Set& set, const typename Set::iterator& it) { return set.key_comp().compared_value(**it); }
+private:
+	template<typename Set, typename Container>
+	static void _int_add_to_set(Set& set, Container& src_container)
+	{
+		for (auto it = _src_begin(src_container); it != src_container.end(); ++it)
+		{
+			PROFILE_COUNT(PROF_SCANNED, 1);
+			set.insert(_get_entity_ptr(it));
+		}
+	}
+	template<typename Set, typename Select, typename Container>
+	static void _int_add_to_set(Set& set, const Select& sel, Container& src_container)
+	{
+		for (auto it = _src_begin(src_container); it != src_container.end(); ++it)
+		{
+			Entity* ptr = _get_entity_ptr(it);
+			PROFILE_COUNT(PROF_SCANNED, 1);
+			if (sel(ptr))
+				set.insert(ptr);
+		}
+	}
+	template<typename Select, typename Container>
+	static int	_int_count(const Select& sel, Container& src_container)
+	{
+		int n = 0;
+		for (auto it = _src_begin(src_container); it != src_container.end(); ++it)
+			n += sel(_get_entity_ptr(it));
+		return n;
+	}
+	template<typename Select, typename Container>
+	static bool	_int_any(const Select& sel, Container& src_container)
+	{
+		for (auto it = _src_begin(src_container); it != src_container.end(); ++it)
+			if (sel(_get_entity_ptr(it)))
+				return true;
+		return false;
+	}
+	//	Sources are read in storage order, a view used as source is never sorted for nothing.
+	template<typename Container>
+	static auto		_src_begin(Container& src_container) -> decltype(src_container.begin()) { return src_container.begin(); }
+	template<typename Key>
+	static EntityViewIterator	_src_begin(EntityView<Key>& src_container) { return src_container.unsorted_begin(); }
+	static int		_capacity() { return 0; }
+	template<typename Container, typename... Containers>
+	static int		_capacity(Container& first, Containers&... rest) { return _size(first) + _capacity(rest...); }
+	template<typename Container>
+	static int		_size(const Container& src_container) { return src_container.size(); }
+	static int		_size(const EntityMask& src_container) { return src_container.count(); }
+	template<typename T, typename... Args>
+	static bool		_and(T first, Args... rest) { return first && _and(rest...); }
+	static bool		_and(bool single) { return single; }
+	static Entity*	_get_entity_ptr(const std::vector<Entity>::iterator& it) { return &*it; }
+	static Entity*	_get_entity_ptr(Entity* it) { return it; }
+	static Entity*	_get_entity_ptr(const EntityMask::iterator& it) { return *it; }
+	static Entity*	_get_entity_ptr(const EntityViewIterator& it) { return *it; }
+};
+
+template<typename Container>
+bool	wind_entities(const Container& windport, Vect wind_dir, int* mana)	//	false (and nothing done) without the mana
+{
+	if (*mana < SPELL_COST)
+		return false;
+	*mana -= SPELL_COST;
+	for (auto it = windport.begin(); it != windport.end(); ++it)
+		if (!(*it)->shield_life)
+			(*it)->displace(wind_dir.scaled(WIND_PUSH));
+	return true;
+}
+
+struct Action	//	Hero command, as understood by the server.
+{
+	enum Type { WAIT, MOVE, WIND, SHIELD, CONTROL };
+
+	Action() : type(WAIT), xy(), target_id(-1) {}
+	Action(int type, const Point& xy, int target_id) : type(type), xy(xy), target_id(target_id) {}
+
+	static Action	wait() { return Action(); }
+	static Action	move(const Point& dst) { return Action(MOVE, dst, -1); }
+	static Action	wind(const Point& dst) { return Action(WIND, dst, -1); }
+	static Action	shield(int id) { return Action(SHIELD, Point(), id); }
+	static Action	control(int id, const Point& dst) { return Action(CONTROL, dst, id); }
+
+	bool			is_spell() const { return type == WIND || type == SHIELD || type == CONTROL; }
+
+	int		type;
+	Point	xy;			// MOVE, WIND and CONTROL destination point
+	int		target_id;	// SHIELD and CONTROL target entity id
+
+	template<typename Out>
+	friend Out&		operator<<(Out& out, const Action& rhs)
+	{
+		switch(rhs.type)
+		{
+			case MOVE:		out << "MOVE " << rhs.xy; break;
+			case WIND:		out << "SPELL WIND " << rhs.xy; break;
+			case SHIELD:	out << "SPELL SHIELD " << rhs.target_id; break;
+			case CONTROL:	out << "SPELL CONTROL " << rhs.target_id << " " << rhs.xy; break;
+			default:		out << "WAIT"; break;
+		}
+		return out;
+	}
+};
+
+//	Fixed capacity game state with a deterministic forward simulation of a full turn.
+//	Player 0 is always us (base at bases[0], heroes type 1), player 1 the opponent.
+//	Nothing here allocates on the heap, so states can be copied and stepped freely.
+//	The whole simulated game in one trivially copyable block, entities inline with their counts :
+//	a snapshot is a memcpy, of only the used part of the monsters array (monsters come last).
+class GameState
+{
+public:
+	GameState() : players(), wild_mana(), heroes_count(0), monsters_count(0), turn(0), hash(0), _controls_count(0) {}
+
+	Point	bases[2];
+	Player	players[2];
+	int		wild_mana[2];	// Mana gained outside of the player base radius (end of game tie break)
+	Entity	heroes[2][MAX_HEROES];
+	int		heroes_count;
+	int		monsters_count;
+	int		turn;
+	uint64_t	hash;		// Zobrist key of the players, entities and pending controls, kept up to date by step
+
+private:
+	struct PendingControl
+	{
+		int		id;
+		Point	dst;
+
+		uint64_t	zobrist() const
+		{
+			return Zobrist::mix(ZOBRIST.pending ^ ZOBRIST.id[id & (Zobrist::IDS - 1)]
+				^ ZOBRIST.x[Zobrist::qx(dst.x)] ^ ZOBRIST.y[Zobrist::qy(dst.y)]);
+		}
+	};
+
+	PendingControl	_controls[2 * MAX_HEROES];
+	int				_controls_count;
+
+public:
+	Entity	monsters[MAX_MONSTERS];	// Last member, see used_size
+
+	//	Bytes up to the last monster, what snapshots copy.
+	size_t	used_size() const { return (const char*)(monsters + monsters_count) - (const char*)this; }
+	//	Same as operator=, without copying the unused monsters slots.
+	void	copy_from(const GameState& src) { memcpy((void*)this, (const void*)&src, src.used_size()); }
+
+	template<typename HeroContainer, typename MonsterContainer>
+	void	load(const Base& base, const Player& me, const Player& adv,
+				const HeroContainer& my_heroes, const HeroContainer& adv_heroes, const MonsterContainer& src_monsters)
+	{
+		bases[0] = base.xy;
+		bases[1] = base.adv;
+		players[0] = me;
+		players[1] = adv;
+		wild_mana[0] = wild_mana[1] = 0;
+		heroes_count = 0;
+		for (auto it = my_heroes.begin(); it != my_heroes.end() && heroes_count < MAX_HEROES; ++it)
+			heroes[0][heroes_count++] = *it;
+		int i = 0;
+		for (auto it = adv_heroes.begin(); it != adv_heroes.end() && i < MAX_HEROES; ++it)
+			heroes[1][i++] = *it;
+		for (; i < heroes_count; ++i)	//	Enemies out of sight are parked on their base, out of reach.
+		{
+			heroes[1][i] = Entity();
+			heroes[1][i].id = -1;
+			heroes[1][i].type = 2;
+			heroes[1][i].xy = heroes[1][i].dst = bases[1];
+		}
+		monsters_count = 0;
+		for (auto it = src_monsters.begin(); it != src_monsters.end() && monsters_count < MAX_MONSTERS; ++it)
+			monsters[monsters_count++] = *it;
+		_controls_count = 0;
+		hash = compute_hash();
+	}
+
+	//	From scratch, step keeps hash equal to it incrementally.
+	uint64_t	compute_hash() const
+	{
+		uint64_t	h = players[0].zobrist(0) ^ players[1].zobrist(1);
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				h ^= heroes[p][i].zobrist();
+		for (int m = 0; m < monsters_count; ++m)
+			h ^= monsters[m].zobrist();
+		for (int c = 0; c < _controls_count; ++c)
+			h ^= _controls[c].zobrist();
+		return h;
+	}
+
+	Entity*	find(int id)
+	{
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				if (heroes[p][i].id == id)
+					return &heroes[p][i];
+		for (int i = 0; i < monsters_count; ++i)
+			if (monsters[i].id == id)
+				return &monsters[i];
+		return nullptr;
+	}
+
+	bool	is_over() const { return players[0].health <= 0 || players[1].health <= 0; }
+
+	//	Applies one turn with the server order :
+	//	CONTROL, SHIELD, heroes moves, attacks and mana, WIND, monsters moves, shields countdown, dead removal.
+	void	step(const Action (&actions)[2][MAX_HEROES])
+	{
+		PROFILE_COUNT(PROF_STEPS, 1);
+		Action	cmd[2][MAX_HEROES];
+		bool	forced[2][MAX_HEROES] = {};
+		Point	forced_dst[2][MAX_HEROES];
+		bool	pushed[MAX_MONSTERS] = {};
+		bool	new_shield[MAX_MONSTERS] = {};
+		bool	new_hero_shield[2][MAX_HEROES] = {};
+
+		//	Controls cast last turn take effect now.
+		auto	release = [](Entity& e) { e.is_controlled = 0; };
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				if (heroes[p][i].is_controlled)
+					heroes[p][i].update(hash, release);
+		for (int i = 0; i < monsters_count; ++i)
+			if (monsters[i].is_controlled)
+				monsters[i].update(hash, release);
+		for (int c = 0; c < _controls_count; ++c)
+		{
+			int	p, i;
+			hash ^= _controls[c].zobrist();
+			if (_hero_index(_controls[c].id, &p, &i))
+			{
+				forced[p][i] = true;
+				forced_dst[p][i] = _controls[c].dst;
+			}
+			else if (Entity* m = find(_controls[c].id))
+			{
+				Point	dst = _controls[c].dst;
+				m->update(hash, [&](Entity& e)
+				{
+					e.vxy = _toward(e.xy, dst, MONSTER_SPEED);
+					e.near_base = 0;
+					e.threat_for = 0;
+				});
+			}
+		}
+		_controls_count = 0;
+
+		//	Commands validation : controlled heroes obey, spells are paid in heroes order or dropped.
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+			{
+				cmd[p][i] = forced[p][i] ? Action::move(forced_dst[p][i]) : actions[p][i];
+				if (!cmd[p][i].is_spell())
+					continue;
+				if (players[p].mana < SPELL_COST || !_valid_spell(heroes[p][i], cmd[p][i]))
+				{
+					cmd[p][i] = Action::wait();
+					continue;
+				}
+				hash ^= players[p].zobrist(p);
+				players[p].mana -= SPELL_COST;
+				hash ^= players[p].zobrist(p);
+			}
+
+		//	CONTROL
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				if (cmd[p][i].type == Action::CONTROL)
+				{
+					find(cmd[p][i].target_id)->update(hash, [](Entity& e) { e.is_controlled = 1; });
+					_controls[_controls_count].id = cmd[p][i].target_id;
+					_controls[_controls_count].dst = cmd[p][i].xy;
+					hash ^= _controls[_controls_count++].zobrist();
+				}
+
+		//	SHIELD (only protects from next turn spells)
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				if (cmd[p][i].type == Action::SHIELD)
+				{
+					int	hp, hi;
+					Entity* e = find(cmd[p][i].target_id);
+					e->update(hash, [](Entity& e) { e.shield_life = SHIELD_DURATION; });
+					if (_hero_index(e->id, &hp, &hi))
+						new_hero_shield[hp][hi] = true;
+					else
+						new_shield[e - monsters] = true;
+				}
+
+		//	Heroes moves
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				if (cmd[p][i].type == Action::MOVE)
+				{
+					Point	dst = cmd[p][i].xy;
+					heroes[p][i].update(hash, [&](Entity& h) { h.xy = _clamp(h.xy + _toward(h.xy, dst, HERO_SPEED)); });
+				}
+
+		//	Attacks and mana gain
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+				for (int m = 0; m < monsters_count; ++m)
+					if (monsters[m].health > 0 && heroes[p][i].xy.in_range(monsters[m].xy, HERO_ATTACK_RANGE))
+					{
+						monsters[m].update(hash, [](Entity& e) { e.health -= HERO_DAMAGE; });
+						hash ^= players[p].zobrist(p);
+						players[p].mana += HERO_DAMAGE;
+						hash ^= players[p].zobrist(p);
+						if (!monsters[m].xy.in_range(bases[p], BASE_RADIUS))
+							wild_mana[p] += HERO_DAMAGE;
+					}
+
+		//	WIND (shields cast this turn do not protect yet)
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+			{
+				if (cmd[p][i].type != Action::WIND)
+					continue;
+				const Entity&	caster = heroes[p][i];
+				Vect			dir(caster.xy, cmd[p][i].xy);
+				if (dir == Vect())
+					continue;
+				Vect			push(dir.scaled(WIND_PUSH));
+				for (int m = 0; m < monsters_count; ++m)
+				{
+					Entity& e = monsters[m];
+					if (e.health > 0 && (!e.shield_life || new_shield[m]) && caster.xy.in_range(e.xy, WIND_RANGE))
+					{
+						e.displace(push, hash);
+						pushed[m] = true;
+					}
+				}
+				for (int j = 0; j < heroes_count; ++j)
+				{
+					Entity& e = heroes[1 - p][j];
+					if (e.id >= 0 && (!e.shield_life || new_hero_shield[1 - p][j]) && caster.xy.in_range(e.xy, WIND_RANGE))
+						e.update(hash, [&](Entity& e) { e.xy = _clamp(e.xy + push); });
+				}
+			}
+
+		//	Monsters moves, base targeting and base damage
+		for (int m = 0; m < monsters_count; ++m)
+		{
+			if (monsters[m].health <= 0)
+				continue;
+			int b;
+			monsters[m].update(hash, [&](Entity& e) { b = move_monster(e, bases, pushed[m]); });
+			if (b >= 0)
+			{
+				hash ^= players[b].zobrist(b);
+				players[b].health -= 1;
+				hash ^= players[b].zobrist(b);
+			}
+		}
+
+		//	Shields countdown
+		for (int p = 0; p < 2; ++p)
+			for (int i = 0; i < heroes_count; ++i)
+			{
+				Entity& h = heroes[p][i];
+				if (h.shield_life > 0 && !new_hero_shield[p][i])
+					h.update(hash, [](Entity& e) { --e.shield_life; });
+				h.dst = h.xy;
+			}
+		for (int m = 0; m < monsters_count; ++m)
+			if (monsters[m].shield_life > 0 && !new_shield[m])
+				monsters[m].update(hash, [](Entity& e) { --e.shield_life; });
+
+		//	Dead and lost monsters removal, keeping order.
+		int	n = 0;
+		for (int m = 0; m < monsters_count; ++m)
+			if (monsters[m].health > 0 && !leaving_map(monsters[m]))
+				monsters[n++] = monsters[m];
+			else
+				hash ^= monsters[m].zobrist();
+		monsters_count = n;
+		++turn;
+	}
+
+	void	step(const Action (&mine)[MAX_HEROES], const Action (&theirs)[MAX_HEROES])
+	{
+		Action	actions[2][MAX_HEROES];
+		for (int i = 0; i < MAX_HEROES; ++i)
+		{
+			actions[0][i] = mine[i];
+			actions[1][i] = theirs[i];
+		}
+		step(actions);
+	}
+
+	//	Out of the map and not coming back : the server removes it.
+	static bool		leaving_map(const Entity& e)
+	{
+		return (e.xy.x < 0 && e.vxy.x <= 0) || (e.xy.x > X_MAX && e.vxy.x >= 0)
+			|| (e.xy.y < 0 && e.vxy.y <= 0) || (e.xy.y > Y_MAX && e.vxy.y >= 0);
+	}
+
+	//	Moves a monster one turn (not if pushed by a wind), then applies base targeting and damage.
+	//	Returns the index of the damaged base (the monster then has 0 health), or -1.
+	static int		move_monster(Entity& e, const Point (&bases)[2], bool pushed = false)
+	{
+		if (!pushed)
+			e.xy = e.xy + e.vxy;
+		int	damaged = -1;
+		for (int b = 0; b < 2; ++b)
+		{
+			if (e.xy.in_range(bases[b], BASE_DAMAGE_RADIUS))
+			{
+				e.health = 0;
+				damaged = b;
+				break;
+			}
+			if (e.xy.in_range(bases[b], BASE_RADIUS))
+			{
+				e.near_base = 1;
+				e.threat_for = b + 1;
+				e.vxy = _toward(e.xy, bases[b], MONSTER_SPEED);
+				break;
+			}
+			if (b == 1)
+				e.near_base = 0;
+		}
+		e.dst = e.xy + e.vxy;
+		return damaged;
+	}
+
+private:
+	bool	_hero_index(int id, int* p, int* i) const
+	{
+		for (*p = 0; *p < 2; ++*p)
+			for (*i = 0; *i < heroes_count; ++*i)
+				if (heroes[*p][*i].id == id)
+					return true;
+		return false;
+	}
+
+	bool	_valid_spell(const Entity& caster, const Action& spell)
+	{
+		if (spell.type == Action::WIND)
+			return true;
+		const Entity* target = find(spell.target_id);
+		return target && target != &caster && (target->type || target->health > 0) && !target->shield_life
+				&& caster.xy.in_range(target->xy, SPELL_RANGE);
+	}
+
+	static Vect		_toward(const Point& from, const Point& to, int speed)
+	{
+		Vect	v(from, to);
+		double	n = v.norm();
+		if (n <= speed)
+			return v;
+		return Vect((int)(v.x * speed / n), (int)(v.y * speed / n));
+	}
+
+	static Point	_clamp(const Point& p)
+	{
+		return Point(std::min(std::max(p.x, 0), X_MAX), std::min(std::max(p.y, 0), Y_MAX));
+	}
+
+};
+
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState snapshots are memcpy");
+
+//	Stack of GameState snapshots in a fixed buffer, for in-place look-ahead without the heap :
+//	push before mutating a state, restore or pop to roll it back. Frames only hold the used part
+//	of the states (GameState::used_size).
+class UndoLog
+{
+public:
+	UndoLog() : _frames(0) { _ends[0] = 0; }
+
+	int		depth() const { return _frames; }
+	void	clear() { _frames = 0; }
+
+	//	False (nothing pushed) when the buffer is full.
+	bool	push(const GameState& s)
+	{
+		size_t	begin = _ends[_frames];
+		size_t	size = s.used_size();
+		if (_frames == UNDO_FRAMES || begin + size > sizeof(_buffer))
+			return false;
+		memcpy(_buffer + begin, (const void*)&s, size);
+		_ends[++_frames] = (begin + size + 7) & ~(size_t)7;
+		return true;
+	}
+	//	Back to the last pushed state, which stays on the stack.
+	void	restore(GameState& s) const { s.copy_from(*(const GameState*)(_buffer + _ends[_frames - 1])); }
+	void	pop(GameState& s)
+	{
+		restore(s);
+		--_frames;
+	}
+
+private:
+	alignas(alignof(GameState)) char	_buffer[UNDO_BYTES];
+	size_t								_ends[UNDO_FRAMES + 1];	// _ends[f] : end of frame f - 1, start of frame f
+	int									_frames;
+};
+
+//	Projected course of a monster, until it damages a base or leaves the map (at most PATH_HORIZON
+//	turns) : its current velocity up to the corner, where it enters a base radius, then a straight
+//	run to that base. Turns are WorldModel turns, so the projection stays valid as turns go by.
+struct Trajectory
+{
+	int		computed;	// Turn of the projection, -1 when invalidated
+	int		base;		// Base it damages or homes in on (0 ours, 1 theirs), -1 for none
+	int		enter;		// Turn it is first in the base radius, -1 for never
+	int		homing;		// Turn of its first move toward the base, -1 for never
+	int		impact;		// Turn it damages the base, -1 for never
+	int		exit;		// Turn it leaves the map, -1 for never
+	Point	corner;		// Where it starts homing, its position if it never does
+	Point	end;		// Where it damages the base or leaves the map
+};
+
+struct Track	//	An entity as known across turns by WorldModel.
+{
+	enum State { VISIBLE, FOGGED, GONE };
+
+	Entity		e;			// Last seen state, or extrapolated from it while fogged
+	int			state;
+	int			seen;		// Turn of last sighting
+	int			base_dist;	// Distance to our base
+	int			eta;		// Turns before this monster damages our base, -1 if it does not on its course
+	Trajectory	path;		// Monsters only, see WorldModel::trajectory
+};
+
+//	Persistent world keyed by entity id, fed with each turn input as a diff :
+//	seen entities are updated or spawned, unseen monsters vanish into fog (and are extrapolated)
+//	or are dropped when they should have been visible (killed, pushed away, base reached).
+//	Derived data (base distance, trajectory, threats ordering) is only recomputed when needed : a
+//	trajectory is kept as long as the monster follows it, and projected again only once a wind, a
+//	control (or a spawn) puts it off course. Attacks only change its health, which its course does
+//	not depend on, and a killed monster is dropped with its track.
+class WorldModel
+{
+public:
+	WorldModel() : count(0), sorted_count(0), turn(0), _free_count(0)
+	{
+		std::fill(_slot_of, _slot_of + MAX_IDS, -1);
+		for (int i = MAX_TRACKS - 1; i >= 0; --i)
+		{
+			tracks[i].state = Track::GONE;
+			_free[_free_count++] = i;
+		}
+	}
+
+	Track	tracks[MAX_TRACKS];
+	int		count;					// Tracks in use (not GONE)
+	int		sorted[MAX_TRACKS];		// Monsters tracks slots : our base threats by ETA, then the others by base distance
+	int		sorted_count;
+	int		turn;
+
+	void	set_bases(const Point& mine, const Point& theirs)
+	{
+		_bases[0] = mine;
+		_bases[1] = theirs;
+	}
+
+	void	begin_turn() { ++turn; }
+
+	Track&	observe(const Entity& e)
+	{
+		int		slot = _find(e.id);
+		bool	spawn = slot < 0;
+		if (spawn)
+			slot = _alloc(e.id);
+		Track&	t = tracks[slot];
+		//	Last turn state, seen or extrapolated in the fog, one move further : still on its course.
+		bool	predicted = false;
+		if (!spawn && e.type == 0)
+		{
+			Entity next = t.e;
+			GameState::move_monster(next, _bases);
+			predicted = next.xy == e.xy && next.vxy == e.vxy;
+		}
+		t.e = e;
+		t.state = Track::VISIBLE;
+		t.seen = turn;
+		t.base_dist = e.xy.dist(_bases[0]);
+		t.eta = -1;
+		if (!predicted)
+			t.path.computed = -1;
+		if (spawn && e.type == 0)
+			sorted[sorted_count++] = slot;
+		return t;
+	}
+
+	//	Projected on the first query after it was invalidated.
+	const Trajectory&	trajectory(Track& t)
+	{
+		if (t.path.computed < 0 && t.e.type == 0)
+			t.path = _project(t.e);
+		return t.path;
+	}
+
+	//	Fog or drop everything not observed this turn, my_heroes being the current vision sources.
+	template<typename HeroContainer>
+	void	end_turn(const HeroContainer& my_heroes)
+	{
+		for (int slot = 0; slot < MAX_TRACKS; ++slot)
+		{
+			Track& t = tracks[slot];
+			if (t.state == Track::GONE || t.seen == turn)
+				continue;
+			if (t.e.type != 0)
+			{
+				t.state = Track::FOGGED;	// Heroes never die, just keep the last sighting.
+				continue;
+			}
+			//	Extrapolated to this turn : where it should be within our vision, it is not (killed or pushed away).
+			bool	lost = GameState::move_monster(t.e, _bases) >= 0 || GameState::leaving_map(t.e)
+				|| turn - t.seen > FOG_MEMORY || _visible(t.e.xy, my_heroes);
+			t.base_dist = t.e.xy.dist(_bases[0]);
+			if (lost)
+				_release(slot);
+			else
+				t.state = Track::FOGGED;
+		}
+		_update_sorted();
+	}
+
+	Track*	find(int id)
+	{
+		int slot = _find(id);
+		return slot < 0 ? nullptr : &tracks[slot];
+	}
+
+private:
+	static const int	MAX_IDS = 4096;		// id hash size (power of 2, > MAX_TRACKS), linear probing
+
+	Point	_bases[2];
+	int		_slot_of[MAX_IDS];	// live track slots only, -1 for empty
+	int		_free[MAX_TRACKS];
+	int		_free_count;
+
+	int		_find(int id) const
+	{
+		for (int h = id & (MAX_IDS - 1); _slot_of[h] >= 0; h = (h + 1) & (MAX_IDS - 1))
+			if (tracks[_slot_of[h]].e.id == id)
+				return _slot_of[h];
+		return -1;
+	}
+	int		_alloc(int id)
+	{
+		if (!_free_count)
+			_evict();
+		int slot = _free[--_free_count];
+		int h = id & (MAX_IDS - 1);
+		while (_slot_of[h] >= 0)
+			h = (h + 1) & (MAX_IDS - 1);
+		_slot_of[h] = slot;
+		tracks[slot].e.id = id;
+		++count;
+		return slot;
+	}
+	//	Backward shift deletion : the entries after the hole move back unless it would put them before their home.
+	void	_release(int slot)
+	{
+		Track& t = tracks[slot];
+		int h = t.e.id & (MAX_IDS - 1);
+		while (_slot_of[h] != slot)
+			h = (h + 1) & (MAX_IDS - 1);
+		for (int j = (h + 1) & (MAX_IDS - 1); _slot_of[j] >= 0; j = (j + 1) & (MAX_IDS - 1))
+		{
+			int home = tracks[_slot_of[j]].e.id & (MAX_IDS - 1);
+			if (((j - home) & (MAX_IDS - 1)) >= ((j - h) & (MAX_IDS - 1)))
+			{
+				_slot_of[h] = _slot_of[j];
+				h = j;
+			}
+		}
+		_slot_of[h] = -1;
+		t.state = Track::GONE;
+		_free[_free_count++] = slot;
+		--count;
+	}
+
+	//	Full (should not happen with FOG_MEMORY) : forget the oldest fogged sighting.
+	void	_evict()
+	{
+		int oldest = 0;
+		for (int slot = 1; slot < MAX_TRACKS; ++slot)
+			if (tracks[slot].state == Track::FOGGED
+				&& (tracks[oldest].state != Track::FOGGED || tracks[slot].seen < tracks[oldest].seen))
+				oldest = slot;
+		_release(oldest);
+		_update_sorted();
+	}
+
+	template<typename HeroContainer>
+	bool	_visible(const Point& p, const HeroContainer& my_heroes) const
+	{
+		if (p.in_range(_bases[0], BASE_VISION))
+			return true;
+		for (auto it = my_heroes.begin(); it != my_heroes.end(); ++it)
+			if (p.in_range(it->xy, HERO_VISION))
+				return true;
+		return false;
+	}
+
+	Trajectory	_project(Entity e) const
+	{
+		Trajectory	path = {turn, -1, -1, -1, -1, -1, e.xy, e.xy};
+		if (e.near_base && e.threat_for > 0)
+		{
+			path.base = e.threat_for - 1;
+			path.enter = path.homing = turn;
+		}
+		for (int t = 1; t <= PATH_HORIZON; ++t)
+		{
+			int b = GameState::move_monster(e, _bases);
+			path.end = e.xy;
+			if (b >= 0)
+			{
+				path.base = b;
+				path.impact = turn + t;
+				break;
+			}
+			if (path.enter < 0 && e.near_base)
+			{
+				path.base = e.threat_for - 1;
+				path.enter = turn + t;
+				path.homing = turn + t + 1;
+				path.corner = e.xy;
+			}
+			if (GameState::leaving_map(e))
+			{
+				path.exit = turn + t;
+				break;
+			}
+		}
+		if (path.enter < 0)
+			path.corner = path.end;
+		return path;
+	}
+
+	//	Our base threats first, soonest impact first, then the others by base distance.
+	bool	_before(const Track& a, const Track& b) const
+	{
+		if ((a.eta >= 0) != (b.eta >= 0))
+			return a.eta >= 0;
+		if (a.eta != b.eta)
+			return a.eta < b.eta;
+		return a.base_dist < b.base_dist;
+	}
+
+	//	Drops released slots, refreshes the ETAs from the trajectories then insertion sorts : the order
+	//	barely changes between turns.
+	void	_update_sorted()
+	{
+		int n = 0;
+		for (int i = 0; i < sorted_count; ++i)
+		{
+			Track& t = tracks[sorted[i]];
+			if (t.state == Track::GONE)
+				continue;
+			const Trajectory& path = trajectory(t);
+			t.eta = path.base == 0 && path.impact >= 0 ? path.impact - turn : -1;
+			sorted[n++] = sorted[i];
+		}
+		sorted_count = n;
+		for (int i = 1; i < sorted_count; ++i)
+		{
+			int slot = sorted[i];
+			int j = i;
+			for (; j > 0 && _before(tracks[slot], tracks[sorted[j - 1]]); --j)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = slot;
+		}
+	}
+};
+
+//	Low resolution, time discounted monster presence over the map, in layers : every monster health,
+//	and the health of the monsters threatening each base. Every turn the tracked monsters add their
+//	health to their cell and the older turns fade by INFLUENCE_DECAY. Rather than scaling every cell
+//	each turn, new contributions are inflated by 1 / INFLUENCE_DECAY per turn (_scale) : an update
+//	only touches the cells of the monsters. Region sums are O(1) from a summed-area table, rebuilt
+//	at most once per turn, on the first query after an update.
+class InfluenceMap
+{
+public:
+	enum Layer { PRESENCE, THREAT_MINE, THREAT_THEIRS, LAYERS };
+
+	InfluenceMap() { clear(); }
+
+	void	clear()
+	{
+		std::fill(&_cells[0][0], &_cells[0][0] + LAYERS * INFLUENCE_W * INFLUENCE_H, 0.);
+		_scale = 1;
+		_dirty = true;
+	}
+	//	Past contributions weigh INFLUENCE_DECAY less from now on.
+	void	next_turn()
+	{
+		_scale /= INFLUENCE_DECAY;
+		if (_scale < 1e12)
+			return;
+		for (int l = 0; l < LAYERS; ++l)	// renormalized a few times per game, before precision suffers
+			for (int c = 0; c < INFLUENCE_W * INFLUENCE_H; ++c)
+				_cells[l][c] /= _scale;
+		_scale = 1;
+		_dirty = true;
+	}
+	void	add(Layer layer, const Point& p, double value)
+	{
+		_cells[layer][cell_y(p.y) * INFLUENCE_W + cell_x(p.x)] += value * _scale;
+		_dirty = true;
+	}
+
+	//	Sum of the cells [cx0, cx1] x [cy0, cy1] (inclusive, clamped to the map).
+	double	sum(Layer layer, int cx0, int cy0, int cx1, int cy1)
+	{
+		cx0 = std::max(cx0, 0);
+		cy0 = std::max(cy0, 0);
+		cx1 = std::min(cx1, INFLUENCE_W - 1);
+		cy1 = std::min(cy1, INFLUENCE_H - 1);
+		if (cx0 > cx1 || cy0 > cy1)
+			return 0;
+		if (_dirty)
+			_build();
+		const double*	s = _sat[layer];
+		const int		w = INFLUENCE_W + 1;
+		return (s[(cy1 + 1) * w + cx1 + 1] - s[cy0 * w + cx1 + 1] - s[(cy1 + 1) * w + cx0] + s[cy0 * w + cx0]) / _scale;
+	}
+	//	Sum of the cells touching the square of half side r around p.
+	double	sum(Layer layer, const Point& p, int r)
+	{
+		return sum(layer, cell_x(p.x - r), cell_y(p.y - r), cell_x(p.x + r), cell_y(p.y + r));
+	}
+
+	static int	cell_x(int x) { return std::min(std::max(x, 0) / INFLUENCE_CELL, INFLUENCE_W - 1); }
+	static int	cell_y(int y) { return std::min(std::max(y, 0) / INFLUENCE_CELL, INFLUENCE_H - 1); }
+
+private:
+	double	_cells[LAYERS][INFLUENCE_W * INFLUENCE_H];
+	double	_sat[LAYERS][(INFLUENCE_W + 1) * (INFLUENCE_H + 1)];	// _sat[(y + 1) * (W + 1) + x + 1] : sum of cells <= (x, y)
+	double	_scale;
+	bool	_dirty;
+
+	void	_build()
+	{
+		const int	w = INFLUENCE_W + 1;
+		for (int l = 0; l < LAYERS; ++l)
+		{
+			double*	s = _sat[l];
+			std::fill(s, s + w, 0.);
+			for (int cy = 0; cy < INFLUENCE_H; ++cy)
+			{
+				double	row = 0;
+				s[(cy + 1) * w] = 0;
+				for (int cx = 0; cx < INFLUENCE_W; ++cx)
+				{
+					row += _cells[l][cy * INFLUENCE_W + cx];
+					s[(cy + 1) * w + cx + 1] = s[cy * w + cx + 1] + row;
+				}
+			}
+		}
+		_dirty = false;
+	}
+};
+
+//	Distance and monster turns to the base of every DIST_CELL cell of the map, for the base at (0,0) :
+//	the other base reads the mirrored cell. Built once, by the constructor of the first Bot (within its first turn budget), then
+//	per turn distances to a base are lookups, within DIST_CELL of the exact value.
+class DistanceTable
+{
+public:
+	static const int	W = X_MAX / DIST_CELL + 1;
+	static const int	H = Y_MAX / DIST_CELL + 1;
+
+	DistanceTable()
+	{
+		for (int cy = 0; cy < H; ++cy)
+			for (int cx = 0; cx < W; ++cx)
+			{
+				Point	center(std::min(cx * DIST_CELL + DIST_CELL / 2, X_MAX), std::min(cy * DIST_CELL + DIST_CELL / 2, Y_MAX));
+				int		d = center.dist(P_ZERO);
+				_dist[cy * W + cx] = d;
+				_turns[cy * W + cx] = d <= BASE_DAMAGE_RADIUS ? 0 : (d - BASE_DAMAGE_RADIUS + MONSTER_SPEED - 1) / MONSTER_SPEED;
+			}
+	}
+
+	//	Shared by every bot (and thread), built on the first call.
+	static const DistanceTable&	get()
+	{
+		static const DistanceTable	table;
+		return table;
+	}
+
+	int		dist(const Point& base, const Point& p) const { return _dist[_cell(base, p)]; }
+	//	Straight moves of a monster to damage the base.
+	int		turns(const Point& base, const Point& p) const { return _turns[_cell(base, p)]; }
+
+private:
+	uint16_t	_dist[W * H];
+	uint8_t		_turns[W * H];
+
+	static int	_cell(const Point& base, const Point& p)
+	{
+		int x = std::min(std::max(base.x ? base.x - p.x : p.x, 0), X_MAX);
+		int y = std::min(std::max(base.y ? base.y - p.y : p.y, 0), Y_MAX);
+		return y / DIST_CELL * W + x / DIST_CELL;
+	}
+};
+
+//	Monotonic wall clock deadline of the current turn : FIRST_TURN_MS for the first one,
+//	TURN_MS for the others, minus a safety margin.
+class Deadline
+{
+public:
+	typedef std::chrono::steady_clock	Clock;
+
+	Deadline() : margin_ms(FIRST_TURN_MARGIN_MS), turn(0), unbounded(false), _start(Clock::now()), _budget_ms(FIRST_TURN_MS) {}
+
+	double	margin_ms;	// Kept free of the current turn budget
+	int		turn;		// Turns started
+	bool	unbounded;	// Never expires (offline replays, bounded by iteration caps instead)
+
+	//	To call as soon as the turn input starts to arrive. The first turn budget also covers the
+	//	initialization, it runs from the construction.
+	void	start_turn()
+	{
+		if (turn++)
+		{
+			_start = Clock::now();
+			_budget_ms = TURN_MS;
+			margin_ms = DEADLINE_MARGIN_MS;
+		}
+	}
+	double	budget_ms() const { return unbounded ? HUGE_VAL : _budget_ms - margin_ms; }
+	double	elapsed_ms() const { return std::chrono::duration<double, std::milli>(Clock::now() - _start).count(); }
+	double	remaining_ms() const { return budget_ms() - elapsed_ms(); }
+	bool	expired() const { return remaining_ms() <= 0; }
+
 private:
-	const Point				_ref;
+	Clock::time_point	_start;
+	double				_budget_ms;
 };
 
-class EntityAngleSelect : public EntitySelect		// Unnary predicate selecting entities on an angle to a given reference vector.
+//	Anytime loop : calls step(iteration) until it returns false or the deadline gets closer
+//	than twice the slowest iteration seen. Returns the number of completed iterations.
+template<typename Step>
+int		anytime(const Deadline& deadline, Step step)
 {
-public:
-	EntityAngleSelect(const Vect& ref_vect, int max) : _ref(ref_vect), EntitySelect(max) {}
-	EntityAngleSelect(const Vect& ref_vect, int min, int max) : _ref(ref_vect), EntitySelect(min, max) {}
-	EntityAngleSelect(const Vect& ref_vect, const std::initializer_list<int>& values) : _ref(ref_vect), EntitySelect(values) {}
-	EntityAngleSelect(const Vect& ref_vect, std::initializer_list<int>&& values) : _ref(ref_vect), EntitySelect(std::move(values)) {}
-	EntityAngleSelect(Vect&& ref_vect, int max) : _ref(std::move(ref_vect)), EntitySelect(max) {}
-	EntityAngleSelect(Vect&& ref_vect, int min, int max) : _ref(std::move(ref_vect)), EntitySelect(min, max) {}
-	EntityAngleSelect(Vect&& ref_vect, const std::initializer_list<int>& values) : _ref(std::move(ref_vect)), EntitySelect(values) {}
-	EntityAngleSelect(Vect&& ref_vect, std::initializer_list<int>&& values) : _ref(std::move(ref_vect)), EntitySelect(std::move(values)) {}
-	virtual	int				selected_value(const Entity& e) const { return e.vxy.angle(_ref); }
-private:
-	const Vect				_ref;
-};
+	double	slowest = 0;
+	int		iterations = 0;
+	for (;;)
+	{
+		double before = deadline.elapsed_ms();
+		if (deadline.budget_ms() - before <= slowest * 2 || !step(iterations))
+			break;
+		++iterations;
+		slowest = std::max(slowest, deadline.elapsed_ms() - before);
+	}
+	return iterations;
+}
 
-//	Utility class for remapping entities pointer including sorting and selection.
-class Remap
+//	UCT tree over joint hero actions, one level per hero : a node at depth d chooses the action of hero
+//	d % heroes at turn d / heroes. Nodes live in a fixed pool, children of a node are contiguous.
+//	Between turns, the subtree reached by the played actions is kept if its predicted state key
+//	matches the observed one, compacted to the front of the other pool.
+class SearchTree
 {
 public:
-	typedef multiset<Entity*, EntityCompare>		EntitySet;
+	struct Node
+	{
+		Action		action;			// Choice of the parent level hero leading here
+		int			first_child;	// -1 while not expanded
+		int			child_count;
+		int			visits;
+		double		value;			// Sum of the backpropagated values
+		uint64_t	key;			// Predicted state key, on turn nodes (depth multiple of heroes)
+	};
 
-	template<typename... Containers>
-	static EntitySet	create_set(const EntityCompare& cmp, Containers&... src_containers)
+	SearchTree() : reused(0), _nodes(MCTS_NODES), _spare(MCTS_NODES), _used(0) { clear(); }
+
+	int		reused;		// Root visits kept from the previous turn
+
+	void	clear()
 	{
-		EntitySet	set(cmp);
-		add_to_set(set, src_containers...);
-		return set;
+		_used = 1;
+		_nodes[0] = Node{Action(), -1, 0, 0, 0, 0};
 	}
-	template<typename... Containers>
-	static EntitySet	create_set(const EntityCompare& cmp, const EntitySelect& sel, Containers&... src_containers)
+
+	Node&	root() { return _nodes[0]; }
+	Node&	node(int i) { return _nodes[i]; }
+	int		used() const { return _used; }
+
+	//	Children storage for n actions, false if the pool is full.
+	bool	expand(int i, const Action* actions, int n)
 	{
-		EntitySet	set(cmp);
-		add_to_set(set, sel, src_containers...);
-		return set;
+		if (_used + n > MCTS_NODES)
+			return false;
+		_nodes[i].first_child = _used;
+		_nodes[i].child_count = n;
+		for (int c = 0; c < n; ++c)
+			_nodes[_used++] = Node{actions[c], -1, 0, 0, 0, 0};
+		return true;
 	}
-	template<typename... Containers>
-	static void add_to_set(EntitySet& set, Containers&... src_containers)
+
+	//	Adds the actions missing among the children of an expanded node, in front of them so they are
+	//	tried first. The children move to the end of the pool, false if it is full.
+	bool	ensure(int i, const Action* actions, int n)
 	{
-		(void)std::initializer_list<int>{(_int_add_to_set(set, src_containers), 0)...};
+		Action	missing[MCTS_ACTIONS];
+		int		m = 0;
+		for (int a = 0; a < n && m < MCTS_ACTIONS; ++a)
+		{
+			bool	found = false;
+			for (int c = _nodes[i].first_child; c < _nodes[i].first_child + _nodes[i].child_count && !found; ++c)
+				found = _same(_nodes[c].action, actions[a]);
+			for (int k = 0; k < m && !found; ++k)
+				found = _same(missing[k], actions[a]);
+			if (!found)
+				missing[m++] = actions[a];
+		}
+		if (!m)
+			return true;
+		if (_used + m + _nodes[i].child_count > MCTS_NODES)
+			return false;
+		int	first = _used;
+		for (int k = 0; k < m; ++k)
+			_nodes[_used++] = Node{missing[k], -1, 0, 0, 0, 0};
+		for (int c = 0; c < _nodes[i].child_count; ++c)
+			_nodes[_used++] = _nodes[_nodes[i].first_child + c];
+		_nodes[i].first_child = first;
+		_nodes[i].child_count += m;
+		return true;
 	}
-	template<typename... Containers>
-	static void add_to_set(EntitySet& set, const EntitySelect& sel, Containers&... src_containers)
+
+	//	Unvisited children first (in actions order), then the best UCB1 score.
+	int		select(int i) const
 	{
-		(void)std::initializer_list<int>{(_int_add_to_set(set, sel, src_containers), 0)...};
+		const Node&	n = _nodes[i];
+		double		log_n = std::log((double)std::max(1, n.visits));
+		int			best = -1;
+		double		best_ucb = -1;
+		for (int c = n.first_child; c < n.first_child + n.child_count; ++c)
+		{
+			const Node& child = _nodes[c];
+			if (!child.visits)
+				return c;
+			double ucb = child.value / child.visits + MCTS_UCB_C * std::sqrt(log_n / child.visits);
+			if (ucb > best_ucb)
+			{
+				best_ucb = ucb;
+				best = c;
+			}
+		}
+		return best;
+	}
+
+	//	Most visited child, -1 if none was visited.
+	int		best_child(int i) const
+	{
+		const Node&	n = _nodes[i];
+		int			best = -1;
+		for (int c = n.first_child; c < n.first_child + n.child_count; ++c)
+			if (_nodes[c].visits && (best < 0 || _nodes[c].visits > _nodes[best].visits))
+				best = c;
+		return best;
 	}
-	static int	compared_value(const EntitySet& set, const Entity& e) { return set.key_comp().compared_value(e); }
-	static int	compared_value(const EntitySet& set, const EntitySet::iterator& it) { return set.key_comp().compared_value(**it); }
+
+	//	New root from the played actions of the heroes and the observed state key, or a fresh tree.
+	void	advance(const Action* played, int heroes, uint64_t key)
+	{
+		int	i = 0;
+		for (int h = 0; h < heroes && i >= 0; ++h)
+		{
+			const Node&	n = _nodes[i];
+			int			next = -1;
+			for (int c = n.first_child; c < n.first_child + n.child_count && next < 0; ++c)
+				if (_same(_nodes[c].action, played[h]))
+					next = c;
+			i = next;
+		}
+		reused = 0;
+		if (i <= 0 || _nodes[i].key != key)
+		{
+			clear();
+			return;
+		}
+		//	Breadth first copy keeps children contiguous.
+		_spare[0] = _nodes[i];
+		int	copied = 1;
+		for (int q = 0; q < copied; ++q)
+		{
+			Node&	n = _spare[q];
+			if (n.first_child < 0)
+				continue;
+			int	first = copied;
+			for (int c = 0; c < n.child_count; ++c)
+				_spare[copied++] = _nodes[n.first_child + c];
+			n.first_child = first;
+		}
+		_nodes.swap(_spare);
+		_used = copied;
+		reused = _nodes[0].visits;
+	}
+
 private:
-	template<typename Container>
-	static void _int_add_to_set(EntitySet& set, Container& src_container)
+	std::vector<Node>	_nodes;
+	std::vector<Node>	_spare;
+	int					_used;
+
+	static bool	_same(const Action& a, const Action& b)
 	{
-		for (auto it = src_container.begin(); it != src_container.end(); ++it)
-			set.insert(_get_entity_ptr(it));
+		return a.type == b.type && a.xy == b.xy && a.target_id == b.target_id;
 	}
-	template<typename Container>
-	static void _int_add_to_set(EntitySet& set, const EntitySelect& sel, Container& src_container)
+};
+
+//	Fixed size cache of state values keyed by GameState::hash : TT_BYTES of cache line buckets of TT_WAYS
+//	entries. An entry stores (key ^ data, data), so a probe never locks : an entry torn by a concurrent
+//	store fails the key check and reads as a miss. Values come with the depth (simulated turns) behind
+//	them; a store replaces the entry of the same key if not deeper, else the shallowest of the bucket,
+//	entries of past generations (turns) first. Probes only hit the current generation.
+class TranspositionTable
+{
+public:
+	TranspositionTable() : hits(0), probes(0), _buckets(TT_BYTES / sizeof(Bucket)), _generation(0) {}
+
+	int		hits;		// Since the last new_generation
+	int		probes;
+
+	void	new_generation()
 	{
-		for (auto it = src_container.begin(); it != src_container.end(); ++it)
+		_generation = (_generation + 1) & 0xFF;
+		hits = probes = 0;
+	}
+
+	bool	probe(uint64_t key, int depth, double* value)
+	{
+		++probes;
+		const Bucket&	b = _bucket(key);
+		for (int w = 0; w < TT_WAYS; ++w)
 		{
-			Entity* ptr = _get_entity_ptr(it);
-			if (sel(ptr))
-				set.insert(ptr);
+			uint64_t	data = b.entries[w].data.load(std::memory_order_relaxed);
+			if ((b.entries[w].key.load(std::memory_order_relaxed) ^ data) != key || _gen(data) != _generation || _depth(data) < depth)
+				continue;
+			float	v;
+			uint32_t bits = (uint32_t)data;
+			memcpy(&v, &bits, sizeof(v));
+			*value = v;
+			++hits;
+			return true;
 		}
+		return false;
 	}
-	template<typename T, typename... Args>
-	static bool		_and(T first, Args... rest) { return first && _and(rest...); }
-	static bool		_and(bool single) { return single; }
-	static Entity*	_get_entity_ptr(const std::vector<Entity>::iterator& it) { return &*it; }
-	static Entity*	_get_entity_ptr(const std::multiset<Entity*>::iterator& it) { return *it; }
+
+	void	store(uint64_t key, int depth, double value)
+	{
+		Bucket&	b = _bucket(key);
+		int		victim = 0;
+		int		victim_depth = INT32_MAX;
+		for (int w = 0; w < TT_WAYS; ++w)
+		{
+			uint64_t	data = b.entries[w].data.load(std::memory_order_relaxed);
+			int			d = _gen(data) == _generation ? _depth(data) : -1;
+			if ((b.entries[w].key.load(std::memory_order_relaxed) ^ data) == key && d >= 0)
+			{
+				if (d > depth)
+					return;
+				victim = w;
+				break;
+			}
+			if (d < victim_depth)
+			{
+				victim = w;
+				victim_depth = d;
+			}
+		}
+		float		v = value;
+		uint32_t	bits;
+		memcpy(&bits, &v, sizeof(bits));
+		uint64_t	data = bits | (uint64_t)std::min(depth, 0xFF) << 32 | (uint64_t)_generation << 40;
+		b.entries[victim].key.store(key ^ data, std::memory_order_relaxed);
+		b.entries[victim].data.store(data, std::memory_order_relaxed);
+	}
+
+private:
+	struct Entry
+	{
+		std::atomic<uint64_t>	key;	// key ^ data
+		std::atomic<uint64_t>	data;	// value (float bits) | depth << 32 | generation << 40
+	};
+	struct alignas(64) Bucket
+	{
+		Entry	entries[TT_WAYS];
+	};
+
+	vector<Bucket>	_buckets;
+	int				_generation;
+
+	Bucket&			_bucket(uint64_t key) { return _buckets[(key >> 32) & (_buckets.size() - 1)]; }
+	static int		_depth(uint64_t data) { return data >> 32 & 0xFF; }
+	static int		_gen(uint64_t data) { return data >> 40 & 0xFF; }
 };
 
-void	wind_entities(const Remap::EntitySet& windport, Vect wind_dir, int* mana)
+struct Plan		//	One command per hero, with the debug message the server displays.
 {
-	*mana -= 10;
-	for (auto it = windport.begin(); it != windport.end(); ++it)
-		if (!(*it)->shield_life)
-			(*it)->displace(Vect(2200, wind_dir.dir()));
-}
+	Action		actions[MAX_HEROES];
+	const char*	labels[MAX_HEROES];
+	int			label_ids[MAX_HEROES];	// Appended to the label if >= 0
+	int			count;
 
-int	main()
+	Plan() : labels(), label_ids(), count(0) {}
+
+	void	set(int i, const Action& action, const char* label, int label_id = -1)
+	{
+		actions[i] = action;
+		labels[i] = label;
+		label_ids[i] = label_id;
+	}
+
+	template<typename Out>
+	friend Out&		operator<<(Out& out, const Plan& rhs)
+	{
+		for (int i = 0; i < rhs.count; ++i)
+		{
+			out << rhs.actions[i];
+			if (rhs.labels[i])
+				out << " " << rhs.labels[i];
+			if (rhs.labels[i] && rhs.label_ids[i] >= 0)
+				out << " " << rhs.label_ids[i];
+			out << '\n';
+		}
+		return out;
+	}
+};
+
+//	Strategy constants. DEFAULT_PARAMS below is the submitted set : Tuner.cpp emits a TunedParams.h
+//	defining it, compiled in with -DTUNED_PARAMS (or pasted over the block for the submission).
+//	Offline, a "name value" file given in the PARAMS_FILE env var overrides it at startup.
+struct Params
 {
-	Player	me;
-	Player	adv;
+	int		post_angle_0;			// defense posts, angles from our base in degrees
+	int		post_angle_1;
+	int		post_angle_2;
+	int		post_radius;			// defense posts distance to our base
+	int		threat_radius;			// monsters heading within it are killed first
+	int		wind_min_targets;		// monsters in wind range to cast the emergency wind
+	int		control_mana;			// mana kept before sending threats to the opponent
+	int		control_cost;			// assignment costs (in turns, as kills) of a CONTROL
+	int		post_cost;				// and of holding a post
+	int		assist_cost;			// extra cost of a second hero on the most urgent threat
+
+	struct Field
+	{
+		const char*		name;
+		int Params::*	member;
+		int				min;	// tuning range, not tuned if min == max
+		int				max;
+	};
+	static const int	FIELDS_COUNT = 10;
+	static const Field	FIELDS[FIELDS_COUNT];
 
-	Base	base;
-	const int&	base_x = base.xy.x;
-	const int&	base_y = base.xy.y;
-	cin >> base; cin.ignore();
+	int		post_angle(int i) const { return i == 0 ? post_angle_0 : i == 1 ? post_angle_1 : post_angle_2; }
 
-	int		heroes_per_player;
-	cin >> heroes_per_player; cin.ignore();
+	static const Field*	field(const char* name)
+	{
+		for (const Field& f : FIELDS)
+			if (!strcmp(f.name, name))
+				return &f;
+		return nullptr;
+	}
+
+	//	Reads "name value" lines, # starts a comment. False if the file cannot be read.
+	bool	load(const char* path)
+	{
+		FILE*	file = fopen(path, "r");
+		if (!file)
+			return false;
+		char	line[256];
+		char	name[64];
+		int		value;
+		while (fgets(line, sizeof(line), file))
+		{
+			if (sscanf(line, "%63s %d", name, &value) != 2 || name[0] == '#')
+				continue;
+			if (const Field* f = field(name))
+				this->*f->member = value;
+			else
+				cerr << path << " : unknown parameter " << name << endl;
+		}
+		fclose(file);
+		return true;
+	}
+};
 
-	//	Create and pre-allocates entities storage vectors.
-	vector<Entity>	heroes;
-	vector<Entity>	enemies;
-	vector<Entity>	monsters;
-	heroes.reserve(3);
-	enemies.reserve(3);
-	monsters.reserve(100);
+const Params::Field	Params::FIELDS[Params::FIELDS_COUNT] = {
+	{"post_angle_0", &Params::post_angle_0, 0, 90},
+	{"post_angle_1", &Params::post_angle_1, 0, 90},
+	{"post_angle_2", &Params::post_angle_2, 0, 90},
+	{"post_radius", &Params::post_radius, 3000, 9000},
+	{"threat_radius", &Params::threat_radius, 3000, 8000},
+	{"wind_min_targets", &Params::wind_min_targets, 1, 5},
+	{"control_mana", &Params::control_mana, SPELL_COST, 200},
+	{"control_cost", &Params::control_cost, 0, 60},
+	{"post_cost", &Params::post_cost, 0, 60},
+	{"assist_cost", &Params::assist_cost, 0, 60}
+};
 
-	clock_t clk_loop_start;
+#ifdef TUNED_PARAMS
+# include "TunedParams.h"
+#else
+static constexpr Params	DEFAULT_PARAMS = {
+	15,		// post_angle_0
+	40,		// post_angle_1
+	65,		// post_angle_2
+	6000,	// post_radius
+	5500,	// threat_radius
+	2,		// wind_min_targets
+	70,		// control_mana
+	25,		// control_cost
+	30,		// post_cost
+	5		// assist_cost
+};
+#endif
 
-	// game loop
-	while (1)
+//	The decision code : turn state storage, the heuristic and its anytime refinement.
+class Bot
+{
+public:
+	Bot(const Base& base, int heroes_per_player, const Params& params = DEFAULT_PARAMS)
+		: base(base), heroes_per_player(heroes_per_player), params(params), search_iterations(INT32_MAX), searched(0),
+		me(), adv(), _distances(&DistanceTable::get())
+	{
+		model.set_bases(base.xy, base.adv);
+		for (int i = 0; i < MAX_HEROES; ++i)
+		{
+			_default_posts[i] = this->base.mirror(Point(0,0)+Vect(params.post_radius, to_rad(params.post_angle(i))));
+			this->base.posts[i] = _default_posts[i];
+			_post_candidates_count[i] = 0;
+		}
+	}
+
+	//	Everything depending only on the base side and the map, on the first turn budget (Deadline
+	//	runs from the construction, which builds the distance tables) : the post candidates, and a
+	//	warm-up of the memory used each turn so the first turns do not page fault in it.
+	void	init()
+	{
+		PROFILE_SCOPE(PROF_INIT);
+		for (int i = 0; i < MAX_HEROES; ++i)
+		{
+			int	lo = i ? (params.post_angle(i - 1) + params.post_angle(i)) / 2 : 0;
+			int	hi = i + 1 < MAX_HEROES ? (params.post_angle(i) + params.post_angle(i + 1)) / 2 : 90;
+			int	n = 0;
+			for (int angle = std::min(lo, hi); angle <= std::max(lo, hi); angle += 5)
+				for (int radius = params.post_radius - 1000; radius <= params.post_radius + 1000 && n < POST_CANDIDATES; radius += 500)
+					_post_candidates[i][n++] = base.mirror(Point(0,0)+Vect(radius, to_rad(angle)));
+			_post_candidates_count[i] = n;
+		}
+		Remap::arena().alloc<EntityViewItem>(4 * WORLD_CAPACITY);
+		Remap::arena().reset();
+		_state.load(base, me, adv, heroes, enemies, monsters);
+		_undo.push(_state);
+		_undo.pop(_sim);
+		influence.sum(InfluenceMap::PRESENCE, base.xy, POST_WINDOW);
+		cerr << "Init : " << deadline.elapsed_ms() << " ms" << endl;
+	}
+
+	Deadline		deadline;		// first : the first turn budget also covers the allocations of the members below
+	Base			base;
+	int				heroes_per_player;
+	Params			params;
+	int				search_iterations;	// MCTS iterations cap per turn, none by default : the deadline ends the search (capped by local batches)
+	int				searched;			// MCTS iterations completed last turn
+	Player			me;
+	Player			adv;
+	EntityArray<MAX_HEROES>		heroes;
+	EntityArray<MAX_HEROES>		enemies;
+	EntityArray<MAX_MONSTERS + 1>	monsters;	// the spare slot parses the next line in place
+	World			world;
+	InterceptSolver	intercepts;		// heroes x world slots, solved at turn start and after each heuristic wind
+	Assignment		assignment;		// heroes x tasks of the turn
+	SearchTree		tree;			// MCTS over the joint hero actions, kept across turns
+	TranspositionTable	tt;			// rollout values of turn states, shared by the tree paths reaching them
+	WindSweep		wind;			// best wind directions
+	WorldModel		model;
+	InfluenceMap	influence;		// discounted monsters presence, fed by the model tracks
+
+	//	Parses a turn straight into the entity storage, false at end of input.
+	template<typename In>
+	bool	read_turn(In& in)
+	{
+		in >> me.health;
+		deadline.start_turn();
+		PROFILE_SCOPE(PROF_PARSE);
+		in >> me.mana;
+		in >> adv;
+		if (in.eof())
+			return false;
+		int entity_count; // Amount of heros and monster you can see
+		in >> entity_count;
+		_begin_turn();
+		//	Entities are parsed in place at the end of monsters (the common case), then moved if heroes.
+		for (int i = 0; i < entity_count; i++)
+		{
+			monsters.emplace_back();
+			in >> monsters.back();
+			_commit_entity();
+		}
+		_end_turn();
+		return true;
+	}
+
+	//	Same from already parsed data (replays, local games).
+	void	load_turn(const Player& me, const Player& adv, const Entity* entities, int entity_count)
+	{
+		deadline.start_turn();
+		this->me = me;
+		this->adv = adv;
+		_begin_turn();
+		for (int i = 0; i < entity_count; i++)
+		{
+			monsters.push_back(entities[i]);
+			_commit_entity();
+		}
+		_end_turn();
+	}
+
+	//	Heuristic answer first, then searched from by MCTS while time remains.
+	Plan	decide()
 	{
-		clk_loop_start = clock();
+		const Point	bases[2] = {base.xy, base.adv};
+		for (int i = 0; i < (int)heroes.size() && i < MAX_HEROES; ++i)	// before the heuristic moves monsters
+		{
+			int k = wind.sweep(world, heroes[i].xy, bases);
+			_root_winds[i] = k >= 0 && wind.scores[k] > 0 ? Action::wind(heroes[i].xy + wind.push(k)) : Action::wait();
+		}
+		Plan	best = _heuristic();
+		_search(best);
+		for (int i = 0; i < best.count; ++i)
+			_played[i] = best.actions[i];
+		return best;
+	}
 
-		//	Clear all entities before reparse.
+private:
+	GameState	_state;		// Turn start state, before the heuristic simulated winds
+	GameState	_sim;		// Search iterations state, rolled back with _undo
+	UndoLog		_undo;
+	Point		_default_posts[MAX_HEROES];
+	Point		_post_candidates[MAX_HEROES][POST_CANDIDATES];
+	int			_post_candidates_count[MAX_HEROES];
+	const DistanceTable*	_distances;	// shared, built by the first Bot, in its first turn budget
+	Action		_played[MAX_HEROES];	// Last turn actions, to reuse the search subtree
+	Action		_root_winds[MAX_HEROES];	// Best sweep winds of the turn start, WAIT if none
+
+	void	_begin_turn()
+	{
+		Remap::arena().reset();
 		heroes.clear();
 		enemies.clear();
 		monsters.clear();
+		model.begin_turn();
+	}
+	void	_commit_entity()
+	{
+		Entity& e = monsters.back();
+		if (e.type == 0 && monsters.full())
+		{
+			monsters.pop_back();	// more monsters than the protocol allows, the spare slot is kept free
+			return;
+		}
+		model.observe(e);
+		if (e.type == 0)
+			return;
+		EntityArray<MAX_HEROES>&	dst = e.type == 1 ? heroes : enemies;
+		if (!dst.full())
+			dst.push_back(e);
+		monsters.pop_back();
+	}
+	void	_end_turn()
+	{
+		model.end_turn(heroes);
+		cerr << "Entity count : " << heroes.size() + enemies.size() + monsters.size() << endl;
+		cerr << "Tracked : " << model.count << " (" << model.sorted_count << " monsters)" << endl;
+
+		_state.load(base, me, adv, heroes, enemies, monsters);
+		//	SoA copy of everything heroes can see, range queries below are single SIMD passes.
+		world.load(monsters, enemies);
+		const Point	bases[2] = {base.xy, base.adv};
+		intercepts.solve(world, heroes, bases);
+
+		influence.next_turn();
+		for (int i = 0; i < model.sorted_count; ++i)
+		{
+			const Track& t = model.tracks[model.sorted[i]];
+			influence.add(InfluenceMap::PRESENCE, t.e.xy, t.e.health);
+			if (t.eta >= 0)
+				influence.add(InfluenceMap::THREAT_MINE, t.e.xy, t.e.health);
+			else if (t.e.threat_for == 2)
+				influence.add(InfluenceMap::THREAT_THEIRS, t.e.xy, t.e.health);
+		}
+		_update_posts();
+	}
 
-		cin >> me; cin.ignore();
-		cin >> adv;	cin.ignore();
+	//	Each post slides within its angular sector (halfway to the neighbouring posts) and within 1000
+	//	of its radius, to the candidate with the most threat for our base around it. It stays at its
+	//	params default while no candidate reaches POST_MIN_THREAT. Candidates come from init.
+	void	_update_posts()
+	{
+		for (int i = 0; i < MAX_HEROES; ++i)
+		{
+			Point	best = _default_posts[i];
+			double	best_threat = POST_MIN_THREAT;
+			for (int c = 0; c < _post_candidates_count[i]; ++c)
+			{
+				double	threat = influence.sum(InfluenceMap::THREAT_MINE, _post_candidates[i][c], POST_WINDOW);
+				if (threat > best_threat)
+				{
+					best = _post_candidates[i][c];
+					best_threat = threat;
+				}
+			}
+			base.posts[i] = best;
+		}
+	}
 
-		int&	health = me.health;
-		int&	mana = me.mana;
+	//	Candidate tasks of every hero, then the min cost joint assignment : emergency winds first,
+	//	then kills of the base threats (intercept turn + turns left to the base), CONTROL of the
+	//	threats in view when mana allows it, and holding posts.
+	Plan	_heuristic()
+	{
+		enum TaskType { WIND, KILL, CONTROL, POST };
+		struct Task
+		{
+			int		type;
+			Entity*	target;
+		};
+		Task	tasks[MAX_TASKS];
+		Plan	plan;
+		int		mana = me.mana;
+		const Point	bases[2] = {base.xy, base.adv};
+
+		plan.count = std::min(heroes_per_player, (int)heroes.size());
+		assignment.reset(plan.count);
+		EntityMask	base_threats_m(world.dst_in_range(base.xy, params.threat_radius));
+		auto		add = [&](int type, Entity* target, bool spell)
+		{
+			int t = assignment.add(spell);
+			if (t >= 0)
+				tasks[t] = Task{type, target};
+			return t;
+		};
+		for (int i = 0; i < plan.count; ++i)
+		{
+			PROFILE_SCOPE(PROF_HERO);
+			EntityMask	windport_m(world.near(heroes[i].xy, WIND_RANGE));
+			cerr << "view[" << i << "] : " << world.near(heroes[i].xy, 2200).count() << '\n';
+			//	Emergency : enough monsters in wind range, one of them at least within our base vision, and
+			//	a direction that gains something (the turn start sweep).
+			if (windport_m.count() >= params.wind_min_targets && mana >= SPELL_COST && (windport_m & world.in_range(base.xy, BASE_VISION)).any()
+				&& _root_winds[i].type == Action::WIND)
+			{
+				int t = add(WIND, nullptr, true);
+				if (t >= 0)
+					assignment.cost[i][t] = 0;
+			}
+			int t = add(POST, nullptr, false);
+			if (t >= 0)
+				assignment.cost[i][t] = params.post_cost;
+		}
+		//	Real ETA order, the threats in range but off our course last : the WorldModel order,
+		//	restricted to the monsters in range (track slot -> world slot).
+		int		threat_slots[MAX_TRACKS];
+		std::fill(threat_slots, threat_slots + MAX_TRACKS, -1);
+		for (auto it = base_threats_m.begin(); it != base_threats_m.end(); ++it)
+			if (Track* track = model.find((*it)->id))
+				threat_slots[track - model.tracks] = it.slot();
+		int	rank = 0;
+		for (int k = 0; k < model.sorted_count; ++k)
+		{
+			const Track&	track = model.tracks[model.sorted[k]];
+			int				slot = threat_slots[model.sorted[k]];
+			if (slot < 0)
+				continue;
+			Entity*	target = world.ref[slot];
+			int		eta = track.eta >= 0 ? track.eta : _distances->turns(base.xy, target->dst);
+			for (int copy = 0; copy < (rank ? 1 : 2); ++copy)	// the most urgent threat may take two heroes
+			{
+				int t = add(KILL, target, false);
+				for (int i = 0; t >= 0 && i < plan.count; ++i)
+					if (intercepts.reachable(i, slot))
+						assignment.cost[i][t] = intercepts.turns[i][slot] + eta + copy * params.assist_cost;
+			}
+			++rank;
+		}
+		if (mana >= params.control_mana)
+		{
+			//	Nearest to our base first, the farthest are the ones left out when the tasks are full.
+			auto	view_threats(Remap::create_set(by(dist_to(base.xy)),
+						member<&Entity::threat_for> == 1 && member<&Entity::shield_life> == 0, monsters));
+			for (Entity* target : view_threats)
+			{
+				int	casters = 0;	// a task no hero can take would only use up a slot
+				for (int i = 0; i < plan.count; ++i)
+					casters |= heroes[i].xy.in_range(target->xy, SPELL_RANGE) << i;
+				int t = casters ? add(CONTROL, target, true) : -1;
+				for (int i = 0; t >= 0 && i < plan.count; ++i)
+					if (casters >> i & 1)
+						assignment.cost[i][t] = params.control_cost;
+			}
+		}
 
-		int entity_count; // Amount of heros and monster you can see
-		cin >> entity_count; cin.ignore();
+		int	chosen[MAX_HEROES];
+		assignment.solve(mana / SPELL_COST, chosen);
+		for (int i = 0; i < plan.count; ++i)
+		{
+			const Task&	task = tasks[chosen[i] < 0 ? 0 : chosen[i]];
+			if (chosen[i] < 0 || task.type == POST)
+				plan.set(i, Action::move(base.get_post(i)), "post", i);
+			else if (task.type == WIND)
+			{
+				//	Swept again, an earlier hero wind may have moved the targets. Still cast without any
+				//	monster gain left : the wind also pushes the opponent heroes, the sweep ignores them.
+				EntityMask	windport_m(world.near(heroes[i].xy, WIND_RANGE));
+				int			k = wind.sweep(world, heroes[i].xy, bases);
+				Vect		dir = k >= 0 ? wind.push(k) : Vect(base.xy, heroes[i].xy).normalize();
+				plan.set(i, Action::wind(heroes[i].xy + dir), "URG");
+				if (wind_entities(windport_m, dir, &mana))
+				{
+					world.sync(windport_m);
+					intercepts.solve(world, heroes, bases);	// the pushed monsters run new paths
+				}
+			}
+			else if (task.type == KILL)
+			{
+				int	slot = world.slot(task.target);
+				plan.set(i, Action::move(intercepts.reachable(i, slot) ? intercepts.point(i, slot) : task.target->dst), "kill", i);
+			}
+			else
+				plan.set(i, Action::control(task.target->id, base.adv), "wololo");
+		}
+		return plan;
+	}
+
+	//	State score : bases health first, then mana, then the pressure of monsters threatening our base.
+	int		_score(const GameState& s) const
+	{
+		int	score = 100000 * (s.players[0].health - s.players[1].health) + 10 * s.players[0].mana;
+		for (int m = 0; m < s.monsters_count; ++m)
+		{
+			const Entity& e = s.monsters[m];
+			if (e.threat_for == 1 && e.xy.in_range(s.bases[0], BASE_VISION))
+				score -= e.health * std::max(0, BASE_VISION - _distances->dist(s.bases[0], e.xy)) / 100;
+		}
+		return score;
+	}
+
+	//	Key of what we see of a state (our heroes, mana and the monsters in sight), order independent.
+	static uint64_t	_key(const GameState& s)
+	{
+		auto		mix = [](uint64_t h) { h ^= h >> 33; h *= 0xff51afd7ed558ccdULL; h ^= h >> 33; return h; };
+		uint64_t	key = mix(s.players[0].mana + 1);
+		for (int i = 0; i < s.heroes_count; ++i)
+			key += mix(((uint64_t)s.heroes[0][i].xy.x << 32 | (uint32_t)s.heroes[0][i].xy.y) + i);
+		for (int m = 0; m < s.monsters_count; ++m)
+		{
+			const Entity&	e = s.monsters[m];
+			bool			seen = e.xy.in_range(s.bases[0], BASE_VISION);
+			for (int i = 0; i < s.heroes_count && !seen; ++i)
+				seen = e.xy.in_range(s.heroes[0][i].xy, HERO_VISION);
+			if (seen)
+				key += mix(((uint64_t)e.xy.x << 32 | (uint32_t)e.xy.y) ^ ((uint64_t)e.id << 48) ^ e.health);
+		}
+		return key;
+	}
 
-		cerr << "Entity count : " << entity_count << endl;
+	//	Nearest monster to our base heading within the threat radius, nullptr if none.
+	const Entity*	_nearest_threat(const GameState& s) const
+	{
+		const Entity*	best = nullptr;
+		for (int m = 0; m < s.monsters_count; ++m)
+		{
+			const Entity& e = s.monsters[m];
+			if (e.dst.in_range(s.bases[0], params.threat_radius) && (!best || e.dst.dist2(s.bases[0]) < best->dst.dist2(s.bases[0])))
+				best = &e;
+		}
+		return best;
+	}
 
-		monsters.reserve(entity_count - 3);
+	//	Rollout policy : every hero runs to the most urgent threat, or back to its post.
+	Action	_default_action(const GameState& s, int hero)
+	{
+		const Entity* threat = _nearest_threat(s);
+		return Action::move(threat ? threat->dst : base.get_post(hero));
+	}
 
-		for (int i = 0; i < entity_count; i++)
+	//	Candidate actions of a hero in a search state : first and extra ones (root level heuristic action
+	//	and best sweep wind), posts, moves to the three most urgent threats,
+	//	winds away from our base in three directions, CONTROL of the nearest threat to the opponent
+	//	and SHIELD of the monster in range closest to the opponent base.
+	int		_candidates(const GameState& s, int hero, const Action* first, const Action* extra, Action (&out)[MCTS_ACTIONS])
+	{
+		int				n = 0;
+		const Entity&	h = s.heroes[0][hero];
+		auto			add = [&](const Action& a)
 		{
-			Entity tmp;
-			cin >> tmp; cin.ignore();
-			switch(tmp.type)
-			{
-				case 2:	enemies.push_back(std::move(tmp)); break;
-				case 1:	heroes.push_back(std::move(tmp)); break;
-				case 0:	monsters.push_back(std::move(tmp)); break;
-			}
+			for (int c = 0; c < n; ++c)
+				if (out[c].type == a.type && out[c].xy == a.xy && out[c].target_id == a.target_id)
+					return;
+			if (n < MCTS_ACTIONS)
+				out[n++] = a;
+		};
+		if (first)
+			add(*first);
+		if (extra && extra->type != Action::WAIT && s.players[0].mana >= SPELL_COST)
+			add(*extra);
+		add(Action::move(base.get_post(hero)));
+		const Entity*	threats[3] = {};
+		for (int m = 0; m < s.monsters_count; ++m)
+		{
+			const Entity* e = &s.monsters[m];
+			if (!e->dst.in_range(s.bases[0], params.threat_radius))
+				continue;
+			for (int t = 0; t < 3; ++t)
+				if (!threats[t] || e->dst.dist2(s.bases[0]) < threats[t]->dst.dist2(s.bases[0]))
+					std::swap(threats[t], e);
+		}
+		for (int t = 0; t < 3 && threats[t]; ++t)
+			add(Action::move(threats[t]->dst));
+		if (s.players[0].mana < SPELL_COST)
+			return n;
+
+		const Entity*	windable = nullptr;
+		const Entity*	shieldable = nullptr;
+		for (int m = 0; m < s.monsters_count; ++m)
+		{
+			const Entity& e = s.monsters[m];
+			if (!e.shield_life && h.xy.in_range(e.xy, WIND_RANGE))
+				windable = &e;
+			if (!e.shield_life && e.threat_for == 2 && h.xy.in_range(e.xy, SPELL_RANGE)
+				&& (!shieldable || e.xy.dist2(s.bases[1]) < shieldable->xy.dist2(s.bases[1])))
+				shieldable = &e;
 		}
+		if (windable)
+		{
+			Vect	away(s.bases[0], h.xy);
+			double	dir = away == Vect() ? M_PI / 4 : away.dir();
+			for (int d = -1; d <= 1; ++d)
+				add(Action::wind(h.xy + Vect(WIND_PUSH, dir + d * M_PI / 4)));
+		}
+		if (threats[0] && !threats[0]->shield_life && h.xy.in_range(threats[0]->xy, SPELL_RANGE))
+			add(Action::control(threats[0]->id, s.bases[1]));
+		if (shieldable)
+			add(Action::shield(shieldable->id));
+		return n;
+	}
 
-		base.posts = {Point(0,0)+Vect(6000, to_rad(15)), Point(0,0)+Vect(6000, to_rad(40)), Point(0,0)+Vect(6000, to_rad(65))};
+	//	A reused tree had its root levels expanded last turn as inner nodes, from a predicted state :
+	//	this turn heuristic action and sweep wind of each hero are added where they miss.
+	void	_seed_root(const Plan& best, int i, int depth, int heroes_count)
+	{
+		if (depth >= heroes_count || tree.node(i).first_child < 0)
+			return;
+		Action	seeds[2] = {best.actions[depth], _root_winds[depth]};
+		int		n = _root_winds[depth].type != Action::WAIT && _state.players[0].mana >= SPELL_COST ? 2 : 1;
+		if (!tree.ensure(i, seeds, n))
+			return;
+		for (int c = 0; c < tree.node(i).child_count; ++c)
+			_seed_root(best, tree.node(i).first_child + c, depth + 1, heroes_count);
+	}
 
-		///	Hero 0		(Defense)
-		for (int i = 0; i < heroes_per_player; ++i)
+	//	MCTS from the turn state, the heuristic plan being the first child tried at each root level.
+	//	The played actions get "mcts" labels when they differ from the heuristic ones.
+	void	_search(Plan& best)
+	{
+		PROFILE_SCOPE(PROF_SEARCH);
+		const int	heroes_count = std::min(best.count, _state.heroes_count);
+		const int	max_depth = MCTS_DEPTH * heroes_count;
+		searched = 0;
+		if (!heroes_count)
+			return;
+		tree.advance(_played, heroes_count, _key(_state));
+		_seed_root(best, 0, 0, heroes_count);
+		tt.new_generation();	// the default policy posts moved
+		_undo.clear();
+		_undo.push(_state);
+
+		int		path[MCTS_DEPTH * MAX_HEROES + 1];
+		int		stable = 0;		// Iterations in a row without a new node nor a new best root child
+		int		best_root = -1;
+		int		done = anytime(deadline, [&](int it)
 		{
+			//	Once the tree stops growing and its root choice settles, more iterations only
+			//	replay the same paths : the rest of the budget is left unused.
+			if (it >= search_iterations || stable >= MCTS_STABLE)
+				return false;
+			bool		grew = false;
+			GameState&	s = _sim;
+			_undo.restore(s);	// back to the turn state
+			Action		actions[2][MAX_HEROES];
+			int			depth = 0;
+			int			i = 0;
+			path[0] = 0;
+			auto		play = [&](const Action& a)
 			{
-				auto	base_view(Remap::create_set(EntityDistCompare(base.xy), monsters, enemies));
-				auto	base_threats(Remap::create_set(EntityDestCompare(base.xy), EntityDestSelect(base.xy, 5500), base_view));
-				auto	viewport(Remap::create_set(EntityDistCompare(heroes[i].xy), EntityDistSelect(heroes[i].xy, 2200), base_view));
-				auto	windport(Remap::create_set(EntityDistCompare(heroes[i].xy), EntityDistSelect(heroes[i].xy, 1280), viewport));
-				auto	view_threats(Remap::create_set(EntityDistCompare(base.xy), EntityMemberSelect("threat_for", {1}), viewport));
-				cerr << "view[" << i << "] : " << viewport.size() << endl;
-				if (windport.size() >= 2 && mana >= 10 && Remap::create_set(EntityDistCompare(base.xy), EntityDistSelect(heroes[i].xy, 6000), windport).size())
+				actions[0][depth % heroes_count] = a;
+				if (++depth % heroes_count == 0)
 				{
-					Vect	dir = Vect(base.xy, heroes[i].xy).normalize();
-					cout << "SPELL WIND " << heroes[i].xy + dir << " URG" << endl;
-					wind_entities(windport, dir, &mana);
-					continue;
+					s.step(actions);
+					for (int h = 0; h < MAX_HEROES; ++h)
+						actions[0][h] = Action::wait();
 				}
-				if (base_threats.size())
+			};
+			//	Selection, then expansion of the reached node.
+			while (depth < max_depth && !s.is_over())
+			{
+				SearchTree::Node& n = tree.node(i);
+				if (n.first_child < 0)
 				{
-					cout << "MOVE " << (*base_threats.begin())->dst << " kill " << i << endl;
-					continue;
+					Action	candidates[MCTS_ACTIONS];
+					int		hero = depth % heroes_count;
+					bool	root = depth < heroes_count;
+					int		count = _candidates(s, hero, root ? &best.actions[hero] : nullptr, root ? &_root_winds[hero] : nullptr, candidates);
+					if (!tree.expand(i, candidates, count))
+						break;
 				}
-				if (mana >= 70 && view_threats.size())
+				int	child = tree.select(i);
+				bool new_leaf = !tree.node(child).visits;
+				play(tree.node(child).action);
+				i = path[depth] = child;
+				if (depth % heroes_count == 0 && new_leaf)
+					tree.node(child).key = _key(s);
+				if (new_leaf)
 				{
-					cout << "SPELL CONTROL " << (*view_threats.begin())->id << " " << base.adv << " wololo"<< endl;
-					continue;
+					grew = true;
+					break;
 				}
-				cout << "MOVE " << base.get_post(i) << " post " << i << endl;
-				continue;
 			}
+			//	Rollout : the rest of the turn, then EVAL_DEPTH turns, with the default policy.
+			//	Those last turns only depend on the reached turn state, their value is cached.
+			PROFILE_COUNT(PROF_ROLLOUTS, 1);
+			const int	tree_depth = depth;
+			while (depth % heroes_count && !s.is_over())
+				play(_default_action(s, depth % heroes_count));
+			const uint64_t	key = s.hash;
+			double			value;
+			if (tt.probe(key, EVAL_DEPTH, &value))
+				PROFILE_COUNT(PROF_TT_HITS, 1);
+			else
+			{
+				for (int d = 0; d < EVAL_DEPTH && !s.is_over(); ++d)
+					for (int h = 0; h < heroes_count; ++h)
+						play(_default_action(s, h));
+				value = 0.5 + 0.5 * std::tanh(_score(s) / MCTS_SCALE);
+				tt.store(key, EVAL_DEPTH, value);
+			}
+			for (int d = 0; d <= tree_depth; ++d)
+			{
+				SearchTree::Node& n = tree.node(path[d]);
+				++n.visits;
+				n.value += value;
+			}
+			int	root_choice = tree.best_child(0);
+			stable = !grew && root_choice == best_root ? stable + 1 : 0;
+			best_root = root_choice;
+			return true;
+		});
+
+		int	i = 0;
+		for (int h = 0; h < heroes_count; ++h)
+		{
+			int child = tree.best_child(i);
+			if (child < 0)
+				break;
+			const Action& a = tree.node(child).action;
+			if (a.type != best.actions[h].type || a.xy != best.actions[h].xy || a.target_id != best.actions[h].target_id)
+				best.set(h, a, "mcts", h);
+			i = child;
+		}
+		searched = done;
+		cerr << "MCTS : " << done << " iterations, " << tree.used() << " nodes, " << tree.reused << " reused visits, "
+			<< tt.hits << "/" << tt.probes << " cached rollouts" << endl;
+	}
+};
+
+#ifndef ANSWER_NO_MAIN	// defined by the offline tools including this file
+int	main()
+{
+	InputScanner	in;
+	CommandWriter	out;
+#ifdef RECORD
+	const char*		record_path = getenv("RECORD_FILE");
+	TurnRecorder	recorder(record_path ? record_path : RECORD_FILE);
+	vector<int>		recorded;
+	in.tap(&recorded);
+#endif
+
+	Base	base;
+	in >> base;
+
+	int		heroes_per_player;
+	in >> heroes_per_player;
+
+	Params	params = DEFAULT_PARAMS;
+	if (const char* params_path = getenv("PARAMS_FILE"))
+		if (!params.load(params_path))
+			cerr << "Cannot read parameters from " << params_path << endl;
+
+	Bot		bot(base, heroes_per_player, params);
+	bot.init();
+#ifdef RECORD
+	recorder.init(recorded, bot.search_iterations);
+	recorded.clear();
+#endif
+
+	// game loop
+	while (bot.read_turn(in))
+	{
+		{
+			PROFILE_SCOPE(PROF_TURN);
+			Plan plan = bot.decide();
+			PROFILE_SCOPE(PROF_OUTPUT);
+			out << plan;
+#ifdef RECORD
+			recorder.turn(recorded, out.data(), out.size(), bot.deadline.elapsed_ms() * 1e6, bot.searched);
+			recorded.clear();
+#endif
+			out.flush();
 		}
+		PROFILE_TURN();
 
-		cerr << "Turn exec_time (in clock ticks) : " << clock() - clk_loop_start << endl;
+		cerr << "Turn exec_time (in ms) : " << bot.deadline.elapsed_ms() << endl;
 	}
+	PROFILE_DUMP();
 }
+#endif
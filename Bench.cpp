@@ -0,0 +1,329 @@
+//	Micro-benchmarks of the Answer.cpp primitives, on synthetic seeded entity sets.
+//	Each case is warmed up, then timed over many samples of a batch of calls sized for about
+//	BENCH_SAMPLE_NS, and reports the median and p99 time per item and the TSC cycles per item.
+//
+//	g++ -std=c++17 -O2 -o bench Bench.cpp
+//	./bench [-f filter] [-n samples] [-s seed] [-o results.tsv]
+//
+//	-f only runs the cases whose name contains filter. -o also writes the results as tab separated
+//	values (one line per case, same columns as the table), to diff runs before and after a change.
+
+#define ANSWER_NO_MAIN
+#include "Answer.cpp"
+
+#include <random>
+#include <x86intrin.h>
+
+#define BENCH_ITEMS 1024		// items of the primitives cases (points, vectors, entities)
+#define BENCH_SAMPLES 200		// timed samples per case
+#define BENCH_WARMUP_NS 20000000	// warm-up time per case
+#define BENCH_SAMPLE_NS 50000	// target duration of a sample
+
+//	Keeps the compiler from dropping a computation whose result is unused.
+template<typename T>
+inline void		do_not_optimize(const T& value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+struct BenchResult
+{
+	std::string	name;
+	int			items;			// per call
+	double		median_ns;		// per item
+	double		p99_ns;			// per item
+	double		cycles;			// TSC cycles per item, median sample
+};
+
+class Bench
+{
+public:
+	Bench(const char* filter, int samples) : _filter(filter), _samples(samples) {}
+
+	vector<BenchResult>	results;
+
+	//	f() processes items items per call.
+	template<typename F>
+	void	run(const std::string& name, int items, F f)
+	{
+		if (_filter && name.find(_filter) == std::string::npos)
+			return;
+		typedef std::chrono::steady_clock	Clock;
+		//	Warm-up, also measures the call time to size the batches.
+		int64_t		calls = 0;
+		auto		start = Clock::now();
+		double		elapsed;
+		do
+		{
+			f();
+			++calls;
+			elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		}
+		while (elapsed < BENCH_WARMUP_NS);
+		int64_t		batch = std::max<int64_t>(1, BENCH_SAMPLE_NS * calls / elapsed);
+
+		vector<double>	ns(_samples);
+		vector<double>	cycles(_samples);
+		for (int s = 0; s < _samples; ++s)
+		{
+			auto		before = Clock::now();
+			uint64_t	tsc = __rdtsc();
+			for (int64_t c = 0; c < batch; ++c)
+				f();
+			cycles[s] = (double)(__rdtsc() - tsc) / (batch * items);
+			ns[s] = std::chrono::duration<double, std::nano>(Clock::now() - before).count() / (batch * items);
+		}
+		std::sort(ns.begin(), ns.end());
+		std::sort(cycles.begin(), cycles.end());
+		results.push_back(BenchResult{name, items, ns[_samples / 2], ns[std::min(_samples - 1, _samples * 99 / 100)],
+			cycles[_samples / 2]});
+		const BenchResult& r = results.back();
+		printf("%-40s %6d %12.2f %12.2f %12.2f\n", r.name.c_str(), r.items, r.median_ns, r.p99_ns, r.cycles);
+		fflush(stdout);
+	}
+
+private:
+	const char*	_filter;
+	int			_samples;
+};
+
+static bool		write_tsv(const char* path, const vector<BenchResult>& results)
+{
+	FILE*	file = fopen(path, "w");
+	if (!file)
+		return false;
+	fprintf(file, "name\titems\tmedian_ns\tp99_ns\tcycles_per_item\n");
+	for (const BenchResult& r : results)
+		fprintf(file, "%s\t%d\t%.3f\t%.3f\t%.3f\n", r.name.c_str(), r.items, r.median_ns, r.p99_ns, r.cycles);
+	return !fclose(file);
+}
+
+//	Monsters (and a few heroes) spread over the map with server like trajectories.
+static vector<Entity>	make_entities(int n, std::mt19937& rng)
+{
+	std::uniform_int_distribution<int>	x(0, X_MAX), y(0, Y_MAX), health(10, 30), angle(0, TRIG_STEPS - 1);
+	vector<Entity>	entities(n);
+	for (int i = 0; i < n; ++i)
+	{
+		Entity& e = entities[i];
+		e = Entity();
+		e.id = i;
+		e.type = i % 10 == 9 ? 1 + i % 2 : 0;
+		e.xy = Point(x(rng), y(rng));
+		e.health = e.type ? 0 : health(rng);
+		e.shield_life = rng() % 8 ? 0 : rng() % SHIELD_DURATION;
+		e.vxy = e.type ? Vect() : Vect::polar(MONSTER_SPEED, angle(rng));
+		e.dst = e.xy + e.vxy;
+		e.near_base = e.xy.in_range(P_ZERO, BASE_RADIUS) || e.xy.in_range(P_MAX, BASE_RADIUS);
+		e.threat_for = e.type ? -1 : rng() % 3;
+	}
+	return entities;
+}
+
+//	Entity lines as sent by the server, parsed back by Entity::operator>> through InputScanner.
+static std::string	entity_text(const vector<Entity>& entities)
+{
+	std::string	text;
+	char		line[128];
+	for (const Entity& e : entities)
+	{
+		snprintf(line, sizeof(line), "%d %d %d %d %d %d %d %d %d %d %d\n", e.id, e.type, e.xy.x, e.xy.y,
+			e.shield_life, e.is_controlled, e.health, e.vxy.x, e.vxy.y, e.near_base, e.threat_for);
+		text += line;
+	}
+	return text;
+}
+
+static void		bench_geometry(Bench& bench, std::mt19937& rng)
+{
+	std::uniform_int_distribution<int>	x(0, X_MAX), y(0, Y_MAX), v(-MONSTER_SPEED, MONSTER_SPEED);
+	std::uniform_real_distribution<double>	rad(-M_PI, M_PI);
+	vector<Point>	points(BENCH_ITEMS);
+	vector<Vect>	vects(BENCH_ITEMS);
+	vector<double>	dirs(BENCH_ITEMS);
+	for (int i = 0; i < BENCH_ITEMS; ++i)
+	{
+		points[i] = Point(x(rng), y(rng));
+		vects[i] = Vect(v(rng), v(rng));
+		dirs[i] = rad(rng);
+	}
+	const Point	ref(X_MAX / 3, Y_MAX / 3);
+	const Vect	ref_v(MONSTER_SPEED, 0);
+
+	bench.run("Point::dist", BENCH_ITEMS, [&]()
+	{
+		int sum = 0;
+		for (const Point& p : points)
+			sum += p.dist(ref);
+		do_not_optimize(sum);
+	});
+	bench.run("Point::in_range", BENCH_ITEMS, [&]()
+	{
+		int sum = 0;
+		for (const Point& p : points)
+			sum += p.in_range(ref, BASE_RADIUS);
+		do_not_optimize(sum);
+	});
+	bench.run("Vect::angle", BENCH_ITEMS, [&]()
+	{
+		double sum = 0;
+		for (const Vect& u : vects)
+			sum += u.angle(ref_v);
+		do_not_optimize(sum);
+	});
+	bench.run("Vect::normalize", BENCH_ITEMS, [&]()
+	{
+		int sum = 0;
+		for (const Vect& u : vects)
+			sum += u.normalize().x;
+		do_not_optimize(sum);
+	});
+	bench.run("Vect(int, double)", BENCH_ITEMS, [&]()
+	{
+		int sum = 0;
+		for (double d : dirs)
+			sum += Vect(WIND_PUSH, d).y;
+		do_not_optimize(sum);
+	});
+}
+
+static void		bench_predicates(Bench& bench, std::mt19937& rng)
+{
+	vector<Entity>	entities = make_entities(BENCH_ITEMS, rng);
+	const Point		ref(X_MAX / 3, Y_MAX / 3);
+	const Vect		ref_v(-MONSTER_SPEED, -MONSTER_SPEED);
+
+	//	Adjacent pairs, as the sorted insertions of a set do.
+	auto	compare = [&](const std::string& name, const EntityCompare& cmp)
+	{
+		bench.run(name, BENCH_ITEMS - 1, [&]()
+		{
+			int sum = 0;
+			for (int i = 0; i + 1 < BENCH_ITEMS; ++i)
+				sum += cmp(&entities[i], &entities[i + 1]);
+			do_not_optimize(sum);
+		});
+	};
+	compare("EntityCompare", EntityCompare());
+	compare("EntityMemberCompare(health)", EntityMemberCompare("health"));
+	compare("EntityDistCompare", EntityDistCompare(ref));
+	compare("EntityDestCompare", EntityDestCompare(ref));
+	compare("EntityAngleCompare", EntityAngleCompare(ref_v));
+
+	auto	select = [&](const std::string& name, const EntitySelect& sel)
+	{
+		bench.run(name, BENCH_ITEMS, [&]()
+		{
+			int sum = 0;
+			for (const Entity& e : entities)
+				sum += sel(&e);
+			do_not_optimize(sum);
+		});
+	};
+	select("EntityMemberSelect(max)", EntityMemberSelect("health", 20));
+	select("EntityMemberSelect(min, max)", EntityMemberSelect("health", 15, 25));
+	select("EntityMemberSelect(values)", EntityMemberSelect("threat_for", {1, 2}));
+	select("EntityDistSelect(max)", EntityDistSelect(ref, BASE_RADIUS));
+	select("EntityDistSelect(min, max)", EntityDistSelect(ref, HERO_VISION, BASE_RADIUS));
+	select("EntityDestSelect(max)", EntityDestSelect(ref, BASE_RADIUS));
+	select("EntityDestSelect(min, max)", EntityDestSelect(ref, HERO_VISION, BASE_RADIUS));
+	select("EntityAngleSelect(max)", EntityAngleSelect(ref_v, 1));
+}
+
+static void		bench_sets(Bench& bench, std::mt19937& rng)
+{
+	const Point	base(P_ZERO);
+	for (int n : {10, 50, 200})
+	{
+		vector<Entity>	entities = make_entities(n, rng);
+		std::string		suffix = "/" + std::to_string(n);
+		bench.run("Remap::create_set(by(dist_to))" + suffix, n, [&]()
+		{
+			Remap::arena().reset();
+			auto set(Remap::create_set(by(dist_to(base)), entities));
+			do_not_optimize(*set.begin());
+		});
+		bench.run("Remap::create_set(by(dist_to), pred)" + suffix, n, [&]()
+		{
+			Remap::arena().reset();
+			auto set(Remap::create_set(by(dist_to(base)), member<&Entity::threat_for> == 1, entities));
+			do_not_optimize(set.size());
+		});
+
+		vector<Entity*>	windport;
+		for (Entity& e : entities)
+			windport.push_back(&e);
+		Vect	dir(1, 1);
+		bench.run("wind_entities" + suffix, n, [&]()
+		{
+			int mana = SPELL_COST;
+			dir = -dir;		// back and forth, positions stay bounded
+			do_not_optimize(wind_entities(windport, dir, &mana));
+		});
+	}
+}
+
+//	InputScanner source serving an in-memory text over and over : each timed pass refills the
+//	scanner from memory, without any syscall.
+struct TextSource
+{
+	TextSource(const std::string& text) : text(&text), pos(0) {}
+	ssize_t	read(char* buf, int size)
+	{
+		int n = std::min<int>(size, text->size() - pos);
+		memcpy(buf, text->data() + pos, n);
+		pos = (pos + n) % text->size();
+		return n;
+	}
+	const std::string*	text;
+	int					pos;
+};
+
+static void		bench_parsing(Bench& bench, std::mt19937& rng)
+{
+	std::string		text = entity_text(make_entities(MAX_MONSTERS, rng));
+	std::unique_ptr<BasicInputScanner<TextSource>>	in(new BasicInputScanner<TextSource>(TextSource(text)));
+	vector<Entity>	entities(MAX_MONSTERS);
+	bench.run("Entity::operator>>", MAX_MONSTERS, [&]()
+	{
+		for (Entity& e : entities)
+			*in >> e;
+		do_not_optimize(entities.back().threat_for);
+	});
+}
+
+int	main(int argc, char** argv)
+{
+	const char*	filter = nullptr;
+	const char*	output = nullptr;
+	int			samples = BENCH_SAMPLES;
+	uint32_t	seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-f") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			samples = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			seed = strtoul(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else
+		{
+			cerr << "usage : " << argv[0] << " [-f filter] [-n samples] [-s seed] [-o results.tsv]" << endl;
+			return 2;
+		}
+	}
+
+	Bench			bench(filter, samples);
+	std::mt19937	rng(seed);
+	printf("%-40s %6s %12s %12s %12s\n", "case", "items", "median ns", "p99 ns", "cycles");
+	bench_geometry(bench, rng);
+	bench_predicates(bench, rng);
+	bench_sets(bench, rng);
+	bench_parsing(bench, rng);
+
+	if (output && !write_tsv(output, bench.results))
+	{
+		cerr << "cannot write " << output << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,371 @@
+//	Local referee : batches of seeded games between two bot policies, run in-process on all cores.
+//	The turn resolution is GameState::step, this file adds what the bots never simulate :
+//	monster spawning, fog of war, the turn limit and the end of game ranking.
+//
+//	g++ -std=c++17 -O2 -pthread -o referee Referee.cpp
+//	./referee [-g games] [-s seed] [-j threads] [-m iterations] [-v] [policy_a] [policy_b]
+//
+//	Policies are answer (the Answer.cpp Bot) and wait (Default.cpp), answer vs wait by default.
+//	-m caps the answer MCTS iterations per turn (default REFEREE_MCTS_ITERATIONS, to keep batches fast).
+//	Each seed is played twice with swapped sides. Prints policy_a wins, draws and losses,
+//	and its score ((wins + draws / 2) / games) with a 95% confidence interval.
+
+#define ANSWER_NO_MAIN
+#include "Answer.cpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+//	Spawning approximates the official referee : a mirrored pair of monsters every SPAWN_EVERY turns,
+//	from the top edge (and bottom edge for the mirror) heading into the map, tougher as the game goes.
+#define MAX_TURNS 220
+#define START_HEALTH 3
+#define SPAWN_EVERY 3
+#define SPAWN_Y -400
+#define SPAWN_X_SPREAD 4000		// spawn points are X_MAX / 2 and X_MAX / 2 + SPAWN_X_SPREAD
+#define SPAWN_MAX_ANGLE_DEG 60	// max angle between a spawned monster trajectory and the vertical
+#define MONSTER_HEALTH 10
+#define MONSTER_HEALTH_EVERY 8	// turns for a new monster to get 1 more health point
+#define THREAT_HORIZON 40		// turns projected to compute threat_for
+#define REFEREE_MCTS_ITERATIONS 300
+
+static int	mcts_iterations = REFEREE_MCTS_ITERATIONS;	// Bot::search_iterations of the answer policies
+
+class Policy	//	A bot as seen by the referee : one call per turn with the fogged view of a player.
+{
+public:
+	virtual ~Policy() {}
+	virtual void	init(const Base& base, int heroes_per_player) = 0;
+	virtual void	play(const Player& me, const Player& adv, const Entity* entities, int entity_count,
+						Action (&actions)[MAX_HEROES]) = 0;
+};
+
+class WaitPolicy : public Policy	//	Default.cpp
+{
+public:
+	void	init(const Base&, int) {}
+	void	play(const Player&, const Player&, const Entity*, int, Action (&actions)[MAX_HEROES])
+	{
+		for (int i = 0; i < MAX_HEROES; ++i)
+			actions[i] = Action::wait();
+	}
+};
+
+class AnswerPolicy : public Policy	//	Answer.cpp
+{
+public:
+	AnswerPolicy(const Params& params = DEFAULT_PARAMS) : _params(params) {}
+
+	void	init(const Base& base, int heroes_per_player)
+	{
+		_bot.reset(new Bot(base, heroes_per_player, _params));
+		_bot->init();
+		_bot->search_iterations = mcts_iterations;
+	}
+	void	play(const Player& me, const Player& adv, const Entity* entities, int entity_count,
+				Action (&actions)[MAX_HEROES])
+	{
+		_bot->load_turn(me, adv, entities, entity_count);
+		Plan plan = _bot->decide();
+		for (int i = 0; i < MAX_HEROES; ++i)
+			actions[i] = i < plan.count ? plan.actions[i] : Action::wait();
+	}
+
+private:
+	Params					_params;
+	std::unique_ptr<Bot>	_bot;
+};
+
+static Policy*	make_policy(const std::string& name)
+{
+	if (name == "answer")
+		return new AnswerPolicy();
+	if (name == "wait")
+		return new WaitPolicy();
+	return nullptr;
+}
+
+class Game
+{
+public:
+	Game(uint32_t seed) : _rng(seed), _next_id(0)
+	{
+		_state.bases[0] = P_ZERO;
+		_state.bases[1] = P_MAX;
+		_state.heroes_count = MAX_HEROES;
+		for (int p = 0; p < 2; ++p)
+		{
+			_state.players[p].health = START_HEALTH;
+			_state.players[p].mana = 0;
+			for (int i = 0; i < MAX_HEROES; ++i)
+			{
+				Entity& h = _state.heroes[p][i];
+				h = Entity();
+				h.id = _next_id++;
+				h.type = p + 1;
+				h.xy = Point(0, 0) + Vect(1000 + 500 * i, to_rad(15 + 30 * i));
+				if (p)
+					h.xy = P_MAX - h.xy;
+				h.dst = h.xy;
+				h.near_base = h.threat_for = -1;
+			}
+		}
+		_state.hash = _state.compute_hash();
+	}
+
+	//	Plays the game, red (base at 0,0) being policies[0]. Returns the winner, -1 for a draw.
+	int		play(Policy* (&policies)[2])
+	{
+		for (int p = 0; p < 2; ++p)
+		{
+			Base base;
+			base.xy = _state.bases[p];
+			base.adv = _state.bases[1 - p];
+			policies[p]->init(base, MAX_HEROES);
+		}
+		while (_state.turn < MAX_TURNS && !_state.is_over())
+		{
+			if (_state.turn % SPAWN_EVERY == 0)
+				_spawn();
+			Action	actions[2][MAX_HEROES];
+			for (int p = 0; p < 2; ++p)
+			{
+				int n = _view(p);
+				policies[p]->play(_state.players[p], _state.players[1 - p], _entities, n, actions[p]);
+			}
+			_state.step(actions);
+		}
+		const Player (&pl)[2] = _state.players;
+		if (pl[0].health != pl[1].health)
+			return pl[0].health > pl[1].health ? 0 : 1;
+		if (_state.wild_mana[0] != _state.wild_mana[1])
+			return _state.wild_mana[0] > _state.wild_mana[1] ? 0 : 1;
+		return -1;
+	}
+
+private:
+	GameState		_state;
+	std::mt19937	_rng;
+	int				_next_id;
+	Entity			_entities[2 * MAX_HEROES + MAX_MONSTERS];
+
+	void	_spawn()
+	{
+		if (_state.monsters_count + 2 > MAX_MONSTERS)
+			return;
+		std::uniform_int_distribution<int>	side(0, 1);
+		std::uniform_int_distribution<int>	angle(-SPAWN_MAX_ANGLE_DEG, SPAWN_MAX_ANGLE_DEG);
+		Entity	m = Entity();
+		m.type = 0;
+		m.health = MONSTER_HEALTH + _state.turn / MONSTER_HEALTH_EVERY;
+		m.xy = Point(X_MAX / 2 + side(_rng) * SPAWN_X_SPREAD, SPAWN_Y);
+		m.vxy = Vect(MONSTER_SPEED, to_rad(90 + angle(_rng)));
+		for (int mirror = 0; mirror < 2; ++mirror)
+		{
+			m.id = _next_id++;
+			m.dst = m.xy + m.vxy;
+			_state.monsters[_state.monsters_count++] = m;
+			_state.hash ^= m.zobrist();
+			m.xy = P_MAX - m.xy;
+			m.vxy = -m.vxy;
+		}
+	}
+
+	//	Fills _entities with what player p sees, with the types and threats of its point of view.
+	int		_view(int p)
+	{
+		int		n = 0;
+		for (int q = 0; q < 2; ++q)
+			for (int i = 0; i < _state.heroes_count; ++i)
+				if (q == p || _visible(p, _state.heroes[q][i].xy))
+				{
+					_entities[n] = _state.heroes[q][i];
+					_entities[n++].type = q == p ? 1 : 2;
+				}
+		for (int m = 0; m < _state.monsters_count; ++m)
+			if (_visible(p, _state.monsters[m].xy))
+			{
+				Entity& e = _entities[n++];
+				e = _state.monsters[m];
+				int	target = _threat(e);
+				e.threat_for = target < 0 ? 0 : target == p ? 1 : 2;
+				e.near_base = e.near_base && target >= 0;
+			}
+		return n;
+	}
+
+	bool	_visible(int p, const Point& xy) const
+	{
+		if (xy.in_range(_state.bases[p], BASE_VISION))
+			return true;
+		for (int i = 0; i < _state.heroes_count; ++i)
+			if (xy.in_range(_state.heroes[p][i].xy, HERO_VISION))
+				return true;
+		return false;
+	}
+
+	//	Base the monster trajectory ends in, -1 if it leaves the map first.
+	int		_threat(Entity e) const
+	{
+		for (int t = 0; t < THREAT_HORIZON; ++t)
+		{
+			for (int b = 0; b < 2; ++b)
+				if (e.xy.in_range(_state.bases[b], BASE_RADIUS))
+					return b;
+			if (GameState::leaving_map(e))
+				return -1;
+			e.xy = e.xy + e.vxy;
+		}
+		return -1;
+	}
+};
+
+//	Work stealing pool : each worker pops games from the front of its own queue,
+//	and steals from the back of the others when it runs dry.
+class WorkStealingPool
+{
+public:
+	WorkStealingPool(int workers) : _queues(workers) {}
+
+	void	push(int worker, int job) { _queues[worker].jobs.push_back(job); }
+
+	template<typename Job>
+	void	run(Job job)
+	{
+		std::vector<std::thread>	threads;
+		for (size_t w = 0; w < _queues.size(); ++w)
+			threads.emplace_back([this, w, &job]() {
+				int j;
+				while (_take(w, &j))
+					job(w, j);
+			});
+		for (std::thread& t : threads)
+			t.join();
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex		lock;
+		std::deque<int>	jobs;
+	};
+
+	bool	_take(size_t w, int* job)
+	{
+		{
+			std::lock_guard<std::mutex>	guard(_queues[w].lock);
+			if (!_queues[w].jobs.empty())
+			{
+				*job = _queues[w].jobs.front();
+				_queues[w].jobs.pop_front();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < _queues.size(); ++i)
+		{
+			Queue&	victim = _queues[(w + i) % _queues.size()];
+			std::lock_guard<std::mutex>	guard(victim.lock);
+			if (!victim.jobs.empty())
+			{
+				*job = victim.jobs.back();
+				victim.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<Queue>	_queues;
+};
+
+struct MatchScore	//	Results of policy a : wins, draws and losses.
+{
+	int		count[3];	// indexed by score : 0 loss, 1 draw, 2 win
+
+	MatchScore() : count() {}
+
+	int		games() const { return count[0] + count[1] + count[2]; }
+	double	score() const { return games() ? (count[2] + count[1] * .5) / games() : 0; }
+	//	Half width of the 95% confidence interval of score(), normal approximation.
+	double	margin() const
+	{
+		double	s = score();
+		double	var = (count[2] * (1 - s) * (1 - s) + count[1] * (.5 - s) * (.5 - s) + count[0] * s * s)
+					/ std::max(1, games() - 1);
+		return 1.96 * std::sqrt(var / std::max(1, games()));
+	}
+};
+
+//	Plays games between new policies from make_a and make_b on a pool of threads.
+//	Game g plays seed + g / 2, policy a being red on even games and blue on odd ones.
+template<typename MakeA, typename MakeB>
+MatchScore	play_match(MakeA make_a, MakeB make_b, int games, uint32_t seed, int threads)
+{
+	std::vector<int>	results(games);		// policy a score : 2 win, 1 draw, 0 loss
+	WorkStealingPool	pool(threads);
+	for (int g = 0; g < games; ++g)
+		pool.push(g * threads / games, g);
+	pool.run([&](int, int g) {
+		int			a = g & 1;
+		Policy*		policies[2];
+		std::unique_ptr<Policy>	pa(policies[a] = make_a());
+		std::unique_ptr<Policy>	pb(policies[1 - a] = make_b());
+		int			winner = Game(seed + g / 2).play(policies);
+		results[g] = winner < 0 ? 1 : winner == a ? 2 : 0;
+	});
+	MatchScore	match;
+	for (int r : results)
+		++match.count[r];
+	return match;
+}
+
+#ifndef REFEREE_NO_MAIN	// defined by the offline tools including this file
+int	main(int argc, char** argv)
+{
+	int							games = 1000;
+	uint32_t					seed = 1;
+	int							threads = std::max(1u, std::thread::hardware_concurrency());
+	bool						verbose = false;
+	std::vector<std::string>	names;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-g" && i + 1 < argc)
+			games = std::max(1, atoi(argv[++i]));
+		else if (arg == "-s" && i + 1 < argc)
+			seed = strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-j" && i + 1 < argc)
+			threads = std::max(1, atoi(argv[++i]));
+		else if (arg == "-m" && i + 1 < argc)
+			mcts_iterations = std::max(0, atoi(argv[++i]));
+		else if (arg == "-v")
+			verbose = true;
+		else
+			names.push_back(arg);
+	}
+	if (names.empty())
+		names.push_back("answer");
+	if (names.size() == 1)
+		names.push_back("wait");
+	if (names.size() > 2 || !std::unique_ptr<Policy>(make_policy(names[0])) || !std::unique_ptr<Policy>(make_policy(names[1])))
+	{
+		cerr << "usage : " << argv[0] << " [-g games] [-s seed] [-j threads] [-m iterations] [-v] [answer|wait] [answer|wait]" << endl;
+		return 2;
+	}
+	if (!verbose)
+		cerr.setstate(std::ios::failbit);	// Bot debug output
+
+	auto		start = std::chrono::steady_clock::now();
+	MatchScore	match = play_match([&]() { return make_policy(names[0]); }, [&]() { return make_policy(names[1]); },
+							games, seed, threads);
+	double		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	cout << names[0] << " vs " << names[1] << " : " << games << " games in " << seconds << " s on "
+		<< threads << " threads" << endl;
+	cout << "wins " << match.count[2] << " draws " << match.count[1] << " losses " << match.count[0] << endl;
+	cout << "score " << match.score() * 100 << "% +/- " << match.margin() * 100 << "% (95% CI)" << endl;
+}
+#endif
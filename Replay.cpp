@@ -0,0 +1,225 @@
+//	Offline replay of turn logs recorded by a -DRECORD build of Answer.cpp.
+//	The logs are mmap'ed and each recorded turn is fed to the same Bot code at full speed,
+//	then the decision is compared with the recorded output. The wall clock deadline is off and
+//	the search runs exactly the iterations the recorded turn completed : replays do not depend on
+//	the machine speed, a divergence means the decision code changed.
+//
+//	g++ -std=c++17 -O2 -o replay Replay.cpp
+//	./replay [-n passes] [-v] turns.rec...
+//
+//	Prints the throughput, the per-turn latency percentiles (replayed and recorded) and the
+//	turns whose output diverges from the record. Exits with 1 if any turn diverged.
+
+#define ANSWER_NO_MAIN
+#include "Answer.cpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_DIVERGENCES_SHOWN 10
+
+//	Integer source for Bot::read_turn over a recorded input block.
+class RecordScanner
+{
+public:
+	RecordScanner(const int32_t* ints, int count) : _ints(ints), _end(ints + count), _eof(false) {}
+
+	bool			eof() const { return _eof; }
+
+	RecordScanner&	operator>>(int& rhs)
+	{
+		_eof = _ints == _end;
+		rhs = _eof ? 0 : *_ints++;
+		return *this;
+	}
+
+private:
+	const int32_t*	_ints;
+	const int32_t*	_end;
+	bool			_eof;
+};
+
+//	Plan text, as CommandWriter would send it.
+class StringWriter
+{
+public:
+	std::string		str;
+
+	template<typename T>
+	StringWriter&	operator<<(const T& rhs)
+	{
+		if constexpr (std::is_arithmetic<T>::value && !std::is_same<T, char>::value)
+			str += std::to_string(rhs);
+		else
+			str += rhs;
+		return *this;
+	}
+};
+
+class TurnLog
+{
+public:
+	TurnLog(const char* path) : _data(nullptr), _size(0)
+	{
+		int			fd = open(path, O_RDONLY);
+		struct stat	st;
+		if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(RecordHeader))
+		{
+			cerr << path << " : cannot read turn log" << endl;
+			if (fd >= 0)
+				close(fd);
+			return;
+		}
+		_size = st.st_size;
+		void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			cerr << path << " : mmap failed" << endl;
+			return;
+		}
+		_data = (const char*)data;
+		madvise(data, _size, MADV_SEQUENTIAL);
+		if (memcmp(header().magic, RECORD_MAGIC, sizeof(header().magic)))
+		{
+			cerr << path << " : not a turn log" << endl;
+			munmap(data, _size);
+			_data = nullptr;
+			return;
+		}
+		_index();
+	}
+	~TurnLog()
+	{
+		if (_data)
+			munmap((void*)_data, _size);
+	}
+
+	struct Turn
+	{
+		const RecordTurn*	record;
+		const int32_t*		input;
+		const char*			output;
+	};
+
+	bool					valid() const { return _data; }
+	const RecordHeader&		header() const { return *(const RecordHeader*)_data; }
+	const int32_t*			init() const { return (const int32_t*)(_data + sizeof(RecordHeader)); }
+	const vector<Turn>&		turns() const { return _turns; }
+
+private:
+	void	_index()
+	{
+		size_t	pos = sizeof(RecordHeader) + header().init_count * sizeof(int32_t);
+		while (pos + sizeof(RecordTurn) <= _size)
+		{
+			Turn	turn;
+			turn.record = (const RecordTurn*)(_data + pos);
+			pos += sizeof(RecordTurn);
+			turn.input = (const int32_t*)(_data + pos);
+			pos += turn.record->input_count * sizeof(int32_t);
+			turn.output = _data + pos;
+			pos += (turn.record->output_len + 3) & ~3;
+			if (pos > _size)
+				break;	// truncated by the judge kill
+			_turns.push_back(turn);
+		}
+	}
+
+	const char*		_data;
+	size_t			_size;
+	vector<Turn>	_turns;
+};
+
+static int64_t	percentile(vector<int64_t>& values, double q)
+{
+	if (values.empty())
+		return 0;
+	size_t	rank = std::min(values.size() - 1, (size_t)(q * values.size()));
+	std::nth_element(values.begin(), values.begin() + rank, values.end());
+	return values[rank];
+}
+
+static void		print_latencies(const char* name, vector<int64_t>& ns)
+{
+	cout << name << " latency (us) : p50 " << percentile(ns, .5) / 1000. << " p90 " << percentile(ns, .9) / 1000.
+		<< " p99 " << percentile(ns, .99) / 1000. << " max " << percentile(ns, 1) / 1000. << endl;
+}
+
+int	main(int argc, char** argv)
+{
+	int					passes = 1;
+	bool				verbose = false;
+	vector<const char*>	paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			passes = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-v"))
+			verbose = true;
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+	{
+		cerr << "usage : " << argv[0] << " [-n passes] [-v] turns.rec..." << endl;
+		return 2;
+	}
+	if (!verbose && !freopen("/dev/null", "w", stderr))	// Bot debug output
+		verbose = true;
+
+	vector<int64_t>	replayed;
+	vector<int64_t>	recorded;
+	int				divergences = 0;
+	auto			start = std::chrono::steady_clock::now();
+
+	for (const char* path : paths)
+	{
+		TurnLog	log(path);
+		if (!log.valid())
+			return 2;
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			//	Fresh bot each pass, the WorldModel history must match the record.
+			RecordScanner	init(log.init(), log.header().init_count);
+			Base			base;
+			int				heroes_per_player;
+			init >> base;
+			init >> heroes_per_player;
+			Bot				bot(base, heroes_per_player);
+			bot.deadline.unbounded = true;
+			bot.init();
+
+			for (size_t t = 0; t < log.turns().size(); ++t)
+			{
+				const TurnLog::Turn&	turn = log.turns()[t];
+				RecordScanner			in(turn.input, turn.record->input_count);
+				StringWriter			out;
+
+				bot.search_iterations = std::min(turn.record->iterations, log.header().search_iterations);
+				auto before = std::chrono::steady_clock::now();
+				if (!bot.read_turn(in))
+					break;
+				out << bot.decide();
+				replayed.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+				if (pass == 0)
+					recorded.push_back(turn.record->elapsed_ns);
+
+				if (out.str.compare(0, std::string::npos, turn.output, turn.record->output_len))
+				{
+					if (++divergences <= MAX_DIVERGENCES_SHOWN)
+						cout << path << " pass " << pass << " turn " << t << " diverges :\n--- recorded\n"
+							<< std::string(turn.output, turn.record->output_len) << "--- replayed\n" << out.str;
+				}
+			}
+		}
+	}
+
+	double	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	cout << replayed.size() << " turns replayed in " << seconds << " s : " << replayed.size() / seconds << " turns/s" << endl;
+	print_latencies("replayed", replayed);
+	print_latencies("recorded", recorded);
+	cout << divergences << " diverging turns" << endl;
+	return divergences ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+//	SPSA tuner of the Answer.cpp strategy Params, on batches of seeded local games (Referee.cpp).
+//	Every iteration plays theta + c * delta and theta - c * delta against the opponent policy on the
+//	same seeds, on all cores, and steps theta along the estimated score gradient.
+//
+//	g++ -std=c++17 -O2 -pthread -o tuner Tuner.cpp
+//	./tuner [-i iterations] [-g games] [-s seed] [-j threads] [-m mcts] [-o answer|wait] [-c checkpoint] [-r] [-H header]
+//
+//	The checkpoint (tuner.ckpt) is rewritten after each iteration, -r resumes from it.
+//	At the end the tuned parameters are written as a params file (tuned.params, for PARAMS_FILE)
+//	and as a constexpr header (TunedParams.h, for -DTUNED_PARAMS builds of Answer.cpp).
+
+#define REFEREE_NO_MAIN
+#include "Referee.cpp"
+
+#define SPSA_A 0.03		// step size gain, about SPSA_C / 4 for a 0.1 score difference
+#define SPSA_C 0.08			// perturbation size, in normalized [0, 1] parameter space
+#define SPSA_ALPHA 0.602
+#define SPSA_GAMMA 0.101
+
+//	Tuned parameters as a vector in [0, 1]^n, mapped linearly on the Params::FIELDS ranges.
+class ParamSpace
+{
+public:
+	ParamSpace()
+	{
+		for (int f = 0; f < Params::FIELDS_COUNT; ++f)
+			if (Params::FIELDS[f].min < Params::FIELDS[f].max)
+				fields.push_back(f);
+	}
+
+	std::vector<int>	fields;		// Params::FIELDS index of each dimension
+
+	int				size() const { return fields.size(); }
+	const char*		name(int d) const { return Params::FIELDS[fields[d]].name; }
+
+	std::vector<double>	normalize(const Params& params) const
+	{
+		std::vector<double>	theta(size());
+		for (int d = 0; d < size(); ++d)
+		{
+			const Params::Field& f = Params::FIELDS[fields[d]];
+			theta[d] = (double)(params.*f.member - f.min) / (f.max - f.min);
+		}
+		return theta;
+	}
+	Params			params(const std::vector<double>& theta) const
+	{
+		Params	params = DEFAULT_PARAMS;
+		for (int d = 0; d < size(); ++d)
+		{
+			const Params::Field& f = Params::FIELDS[fields[d]];
+			params.*f.member = f.min + (int)std::lround(clamp(theta[d]) * (f.max - f.min));
+		}
+		return params;
+	}
+
+	static double	clamp(double t) { return std::min(1., std::max(0., t)); }
+};
+
+static bool		save_checkpoint(const char* path, const ParamSpace& space, int iteration, const std::vector<double>& theta)
+{
+	FILE*	file = fopen(path, "w");
+	if (!file)
+		return false;
+	fprintf(file, "# SPSA tuner checkpoint, normalized parameters\niteration %d\n", iteration);
+	for (int d = 0; d < space.size(); ++d)
+		fprintf(file, "%s %.9f\n", space.name(d), theta[d]);
+	return !fclose(file);
+}
+
+static bool		load_checkpoint(const char* path, const ParamSpace& space, int* iteration, std::vector<double>& theta)
+{
+	FILE*	file = fopen(path, "r");
+	if (!file)
+		return false;
+	char	line[256];
+	char	name[64];
+	double	value;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "%63s %lf", name, &value) != 2 || name[0] == '#')
+			continue;
+		if (!strcmp(name, "iteration"))
+			*iteration = value;
+		for (int d = 0; d < space.size(); ++d)
+			if (!strcmp(name, space.name(d)))
+				theta[d] = value;
+	}
+	fclose(file);
+	return true;
+}
+
+static bool		write_header(const char* path, const Params& params, const MatchScore& match)
+{
+	FILE*	file = fopen(path, "w");
+	if (!file)
+		return false;
+	fprintf(file, "//	Generated by Tuner.cpp (score %.1f%% +/- %.1f%% over %d games), included by Answer.cpp with -DTUNED_PARAMS.\n",
+		match.score() * 100, match.margin() * 100, match.games());
+	fprintf(file, "static constexpr Params	DEFAULT_PARAMS = {\n");
+	for (int f = 0; f < Params::FIELDS_COUNT; ++f)	//	FIELDS are in the members order
+		fprintf(file, "\t%d%s\t// %s\n", params.*Params::FIELDS[f].member, f + 1 < Params::FIELDS_COUNT ? "," : "",
+			Params::FIELDS[f].name);
+	fprintf(file, "};\n");
+	return !fclose(file);
+}
+
+int	main(int argc, char** argv)
+{
+	int			iterations = 50;
+	int			games = 200;
+	uint32_t	seed = 1;
+	int			threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string	opponent = "answer";
+	const char*	checkpoint = "tuner.ckpt";
+	const char*	header = "TunedParams.h";
+	bool		resume = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-i" && i + 1 < argc)
+			iterations = std::max(0, atoi(argv[++i]));
+		else if (arg == "-g" && i + 1 < argc)
+			games = std::max(2, atoi(argv[++i]));
+		else if (arg == "-s" && i + 1 < argc)
+			seed = strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-j" && i + 1 < argc)
+			threads = std::max(1, atoi(argv[++i]));
+		else if (arg == "-m" && i + 1 < argc)
+			mcts_iterations = std::max(0, atoi(argv[++i]));
+		else if (arg == "-o" && i + 1 < argc)
+			opponent = argv[++i];
+		else if (arg == "-c" && i + 1 < argc)
+			checkpoint = argv[++i];
+		else if (arg == "-H" && i + 1 < argc)
+			header = argv[++i];
+		else if (arg == "-r")
+			resume = true;
+		else
+		{
+			cerr << "usage : " << argv[0] << " [-i iterations] [-g games] [-s seed] [-j threads] [-m mcts] [-o answer|wait]"
+				<< " [-c checkpoint] [-r] [-H header]" << endl;
+			return 2;
+		}
+	}
+	if (!std::unique_ptr<Policy>(make_policy(opponent)))
+	{
+		cerr << "unknown opponent " << opponent << endl;
+		return 2;
+	}
+
+	ParamSpace			space;
+	std::vector<double>	theta = space.normalize(DEFAULT_PARAMS);
+	int					first = 0;
+	if (resume && !load_checkpoint(checkpoint, space, &first, theta))
+	{
+		cerr << "cannot resume from " << checkpoint << endl;
+		return 2;
+	}
+	cerr.setstate(std::ios::failbit);	// Bot debug output
+
+	auto	make_opponent = [&]() { return make_policy(opponent); };
+	std::mt19937	rng(seed + first);
+	for (int k = first; k < iterations; ++k)
+	{
+		double	ak = SPSA_A / std::pow(k + 1 + iterations / 10., SPSA_ALPHA);
+		double	ck = SPSA_C / std::pow(k + 1, SPSA_GAMMA);
+		std::vector<double>	delta(space.size());
+		std::vector<double>	plus(theta);
+		std::vector<double>	minus(theta);
+		for (int d = 0; d < space.size(); ++d)
+		{
+			delta[d] = rng() & 1 ? 1 : -1;
+			plus[d] = ParamSpace::clamp(theta[d] + ck * delta[d]);
+			minus[d] = ParamSpace::clamp(theta[d] - ck * delta[d]);
+		}
+		//	Same seeds on both sides : most of the games noise cancels out in the difference.
+		uint32_t	batch_seed = seed + (uint32_t)k * games;
+		Params		params_plus = space.params(plus);
+		Params		params_minus = space.params(minus);
+		MatchScore	score_plus = play_match([&]() { return new AnswerPolicy(params_plus); }, make_opponent,
+								games, batch_seed, threads);
+		MatchScore	score_minus = play_match([&]() { return new AnswerPolicy(params_minus); }, make_opponent,
+								games, batch_seed, threads);
+		double		diff = score_plus.score() - score_minus.score();
+		for (int d = 0; d < space.size(); ++d)
+			theta[d] = ParamSpace::clamp(theta[d] + ak * diff / (2 * ck * delta[d]));
+
+		cout << "iteration " << k << " : + " << score_plus.score() * 100 << "% - " << score_minus.score() * 100 << "% |";
+		Params	params = space.params(theta);
+		for (int d = 0; d < space.size(); ++d)
+			cout << " " << space.name(d) << " " << params.*Params::FIELDS[space.fields[d]].member;
+		cout << endl;
+		if (!save_checkpoint(checkpoint, space, k + 1, theta))
+			cout << "cannot write checkpoint " << checkpoint << endl;
+	}
+
+	//	Final check on fresh seeds, twice the batch size.
+	Params		tuned = space.params(theta);
+	MatchScore	final_score = play_match([&]() { return new AnswerPolicy(tuned); }, make_opponent,
+							2 * games, seed + (uint32_t)iterations * games, threads);
+	cout << "tuned vs " << opponent << " : " << final_score.score() * 100 << "% +/- " << final_score.margin() * 100
+		<< "% (95% CI, " << final_score.games() << " games)" << endl;
+
+	FILE*	file = fopen("tuned.params", "w");
+	if (file)
+	{
+		for (int f = 0; f < Params::FIELDS_COUNT; ++f)
+			fprintf(file, "%s %d\n", Params::FIELDS[f].name, tuned.*Params::FIELDS[f].member);
+		fclose(file);
+	}
+	if (!file || !write_header(header, tuned, final_score))
+	{
+		cerr.clear();
+		cerr << "cannot write the tuned parameters" << endl;
+		return 1;
+	}
+	cout << "written tuned.params and " << header << endl;
+}